@@ -49,28 +49,45 @@ U64 Board::getSquareAttackers(U64 sq, short SIDE) {
 
     return attacks;
 }
-void Board::getSmallestAttacker(short attackedSquare, short &smallestAttackerSquare, short &cheapestPiece) {
-    // gets the smallest attacker of attackedSquare from currentSide
-    // returns the attacking type and attacking square by value
-
-    U64 attackers = getSquareAttackers(toBB(attackedSquare), currentSide);
+U64 Board::getAttackersTo(short sq, U64 occupied) {
+    // returns the attackers of sq from both sides, given an occupancy. used by SEE, where pieces are taken off the occupancy as they capture
+    U64 sqBB = toBB(sq);
+    U64 empty = ~occupied;
+
+    U64 diag, horiz, knight, king, pawn;
+    diag = genAttack<BISHOP>(sqBB, empty) & (pieceBB[BISHOP] | pieceBB[QUEEN]);
+    horiz = genAttack<ROOK>(sqBB, empty) & (pieceBB[ROOK] | pieceBB[QUEEN]);
+    knight = knightMasks[sq] & pieceBB[KNIGHT];
+    king = kingMasks[sq] & pieceBB[KING];
+    pawn = (genPawnAttacks(sqBB, BLACK) & pieceBB[PAWN] & pieceBB[nWhite]) |
+           (genPawnAttacks(sqBB, WHITE) & pieceBB[PAWN] & pieceBB[nBlack]); // pawns need to move in opposite direction
+
+    return (diag | horiz | knight | king | pawn) & occupied;
+}
+U64 Board::getSliderAttackersTo(short sq, U64 occupied) {
+    // returns the sliders that attack sq. after a piece is taken off the occupancy, this finds the x-rays behind it
+    U64 sqBB = toBB(sq);
+    U64 empty = ~occupied;
 
-    if (attackers == 0) {
-        smallestAttackerSquare = -1;
-        return;
-    }
+    U64 diag, horiz;
+    diag = genAttack<BISHOP>(sqBB, empty) & (pieceBB[BISHOP] | pieceBB[QUEEN]);
+    horiz = genAttack<ROOK>(sqBB, empty) & (pieceBB[ROOK] | pieceBB[QUEEN]);
 
-    // loop through all pieces in order of worth
+    return (diag | horiz) & occupied;
+}
+short Board::getLeastValuableAttacker(U64 attackers, U64 &attackerBB) {
+    // returns the cheapest piece type in attackers, and sets attackerBB to a single one of them
     for (short piece = PAWN; piece <= KING; piece++) {
-        // get the pieces that are also attackers
         U64 pieceAttackers = pieceBB[piece] & attackers;
 
         if (pieceAttackers == 0) continue;
 
-        smallestAttackerSquare = bitScanForward(pieceAttackers);
-        cheapestPiece = piece;
-        return;
+        attackerBB = pieceAttackers & -pieceAttackers; // isolate the lowest set bit
+        return piece;
     }
+
+    attackerBB = 0;
+    return EMPTY;
 }
 U64 Board::getEmptySquares() {
     return emptySquares;
@@ -161,27 +178,34 @@ void Board::readFENInner(string FEN) {
             case 'K':
                 // white can castle king side
                 CastleRights |= 2;
+                break;
             case 'Q':
                 CastleRights |= 1;
+                break;
             case 'k':
                 CastleRights |= 8;
+                break;
             case 'q':
                 CastleRights |= 4;
+                break;
         }
     }
 
     /* now deal with en-passant rights */
     string enpassSquare = sections[3];
-    U64 enPassantRights = 0;
-    if (enpassSquare != "-") {
-        enPassantRights = int(enpassSquare[0]) - int('a');
-        enPassantRights = toBB(enPassantRights);
+    enPassantRights = 0;
+    if (!enpassSquare.empty() && enpassSquare != "-") {
+        enPassantRights = toBB(int(enpassSquare[0]) - int('a'));
+    }
+
+    /* and the half move clock. some FENs leave it out */
+    halfMoveClock = 0;
+    if (!sections[4].empty() && isdigit(sections[4][0])) {
+        halfMoveClock = stoi(sections[4]);
     }
-    enPassantRights = enPassantRights;
 
-    moveHistory.clear();
-    enPassantHistory.clear();
-    CastleRightsHistory.clear();
+    moveNumber = 1;
+    stack[moveNumber] = StackEntry();
 }
 
 /* Setters */
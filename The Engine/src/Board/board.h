@@ -6,6 +6,41 @@
 #define SEARCH_CPP_BOARD_H
 
 
+#define MAX_GAME_LENGTH 2048 // the most moves the game and the search can make between them
+
+/* The stack
+ * There is one entry for every move made since the FEN was read, indexed by moveNumber (which starts at 1).
+ * Entry moveNumber holds the state of the current position that a move can't undo, and the move made from it. The search also keeps its per-ply data here.
+ * It's a fixed array, so making a move doesn't allocate, and each entry sits in its own cache lines.
+ * (The move lists in each entry do allocate, but only the first few times the search reaches that ply, until they've grown.)
+ * Nothing can be made once moveNumber reaches MAX_GAME_LENGTH - 1, so the search stops deepening there, and the UCI stops applying moves.
+ * */
+struct PieceChange {
+    // a piece added to (sign = 1) or removed from (sign = -1) a square by a move
+    short piece, side, square, sign;
+};
+struct alignas(64) StackEntry {
+    /* Board state, saved when a move is made from this position */
+    Move move = 0; // the move made from this position (0 for a null move)
+    CRights castleRights = 0;
+    EnPassantRights enPassantRights = 0;
+    short halfMoveClock = 0;
+    PieceChange changes[4]; // the pieces the move added and removed (castling changes four). used to update the NNUE accumulators
+    short numChanges = 0;
+
+    /* Search state */
+    U64 key = 0; // the zobrist hash of this position
+    U64 pawnKey = 0; // the zobrist hash of just the pawns
+    U64 materialKey = 0; // the zobrist hash of the piece counts
+    int material[2] = {}; // the middlegame and endgame material evaluations of this position
+    short phase = 0; // the game phase of this position
+    int staticEval = 0;
+    Move killers[2] = {}; // two quiet moves that caused a cut-off at this ply
+    Move excludedMove = 0; // the move left out of a singular extension search
+    MoveList moves; // the move list for negamax at this ply. it keeps its capacity, so we don't allocate once it's grown
+    MoveList qMoves; // the move list for the quiescence search (it can run at the same ply as negamax e.g. razoring)
+};
+
 /*
  * This is the board class. It runs the game of chess, in a bare-bones form.
  * It only contains methods and attributes that are essential for chess to run.
@@ -22,13 +57,13 @@ protected:
     U64 attackMap; // map of attacked squares, used to stop king from moving into check
     U64 checkingRay; // holds the acceptable squares for a move to land
 
-    /* History stuff. This is needed for undoing moves */
+    /* Move lists */
     MoveList activeMoveList; // stores the active moves
     MoveList quietMoveList; // stores the quiet moves
     MoveList combinedMoveList; // stores both types of moves
-    MoveList moveHistory; // stores past moves
-    vector<EnPassantRights> enPassantHistory; // stores past en-passant rights
-    vector<CRights> CastleRightsHistory; // stores previous castle rights
+
+    /* History stuff. This is needed for undoing moves */
+    StackEntry stack[MAX_GAME_LENGTH];
 
     /* Board status stuff */
     // two variables keep track of the current side, as one is needed to index an array.
@@ -38,6 +73,7 @@ protected:
     EnPassantRights enPassantRights = 0;
     bool inCheck; // holds whether board in check
     short moveNumber = 1; // how many moves have been made
+    short halfMoveClock = 0; // the number of plies since the last capture or pawn move. used for the fifty move rule, and to bound repetition checks
 
 
     /* Move gen stuff (completely self-contained) */
@@ -70,6 +106,7 @@ protected:
     void innerUnMakeMove();
     inline void decodeMove(Move move, short &from, short &to, short &promo, short &flag, short &fromType, short &toType);
     inline void clearEnPassRights();
+    Move lastMove() {return (moveNumber > 1) ? stack[moveNumber - 1].move : 0;}
     inline void doEnPass(short &fromType, short &toType, short &from, short &to);
     void updateCastleRights();
     inline void undoCastleRights();
@@ -82,7 +119,9 @@ protected:
 
     /* getters - a lot of these can only be used once moves have been generated */
     bool canCastle(short SIDE);
-    void getSmallestAttacker(short attackedSquare, short &smallestAttackerSquare, short &cheapestPiece);
+    U64 getAttackersTo(short sq, U64 occupied);
+    U64 getSliderAttackersTo(short sq, U64 occupied);
+    short getLeastValuableAttacker(U64 attackers, U64 &attackerBB);
     U64 getEmptySquares();
 
 
@@ -2,6 +2,7 @@
 // Created by Noah Joubert on 28/07/2023.
 //
 
+#include <cassert>
 #include "board.h"
 
 #ifndef SEARCH_MAKEMOVECPP
@@ -15,20 +16,33 @@ void Board::innerMakeMove(Move move) {
     // inner function used to make a move
 
     /* How does this work?
-     * 1. Add the move to the moveHistory. Increment moveNumber.
-     * 2. Clear the enPassantRights
+     * 1. Save the move, and the castling/ en-passant rights and half move clock on the stack. Increment moveNumber.
+     * 2. Clear the enPassantRights, and update the half move clock
      * 3. Execute the move, considering what type of move it is (eg. pawn push, capture, promotion)
      * 4. Update castling rights
      * 5. Switch side
      */
 
-    moveHistory.emplace_back(move);
+    assert(moveNumber < MAX_GAME_LENGTH - 1); // the stack is full
+    StackEntry &entry = stack[moveNumber];
+    entry.move = move;
+    entry.castleRights = CastleRights;
+    entry.enPassantRights = enPassantRights;
+    entry.halfMoveClock = halfMoveClock;
+
     moveNumber ++;
     clearEnPassRights();
 
     short from, to, promo, flag, fromType, toType;
     decodeMove(move, from, to, promo, flag, fromType, toType);
 
+    // captures and pawn moves can't be undone, so reset the half move clock
+    if ((fromType == PAWN) || ((toType != EMPTY) && (flag != CASTLING))) {
+        halfMoveClock = 0;
+    } else {
+        halfMoveClock ++;
+    }
+
     if (flag == ENPASSANT) {
         /* en passant */
         doEnPass(fromType, toType, from, to);
@@ -69,18 +83,18 @@ void Board::innerUnMakeMove() {
     // inner function used to un-make a move
 
     /* How does this work
-     * 1. Pop the last move from history
+     * 1. Decrease the moveNumber, and get the last move from the stack
      * 2. Reload the previous enPassantRights & castling rights
      * 3. Switch the side back
      * 4. Run the move in reverse
      * */
 
-    Move move = moveHistory.back(); // get the last move played
-    moveHistory.pop_back();
     moveNumber--; // decrease the move number
+    Move move = stack[moveNumber].move; // get the last move played
 
     undoEnPassRights();
     undoCastleRights();
+    halfMoveClock = stack[moveNumber].halfMoveClock;
 
     innerSwitchSide(); // switch the side
 
@@ -127,8 +141,7 @@ inline void Board::decodeMove(Move move, short &from, short &to, short &promo, s
     toType = (move & toTypeMask) >> 19;
 }
 inline void Board::clearEnPassRights() {
-    // update zobrist key by removing any previous en-passants.
-    enPassantHistory.emplace_back(enPassantRights);
+    // the old rights are saved on the stack before this is called
     enPassantRights = 0;
 }
 inline void Board::doEnPass(short &fromType, short &toType, short &from, short &to) {
@@ -148,8 +161,6 @@ inline void Board::doEnPass(short &fromType, short &toType, short &from, short &
     setSquare(toType, otherSide, enPassSquare);
 }
 void Board::updateCastleRights() {
-    CastleRightsHistory.emplace_back(CastleRights);
-
     U64 w = (pieceBB[KING] | pieceBB[ROOK]) & pieceBB[nWhite];
     if ((CastleRights & 1) && (w & CastleMasks[WHITE][0]) != CastleMasks[WHITE][0]) {
         CastleRights ^= 1;
@@ -167,12 +178,11 @@ void Board::updateCastleRights() {
     }
 }
 inline void Board::undoCastleRights() {
-    CastleRights = CastleRightsHistory.back();
-    CastleRightsHistory.pop_back();
+    // the move number must already have been decreased
+    CastleRights = stack[moveNumber].castleRights;
 }
 inline void Board::undoEnPassRights() {
-    enPassantRights = enPassantHistory.back();
-    enPassantHistory.pop_back();
+    enPassantRights = stack[moveNumber].enPassantRights;
 }
 inline void Board::doCastle(short &fromType, short &toType, short &from, short &to) {
     // first reset the castle and king squares
@@ -0,0 +1,168 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include "../Search/SearchController.cpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef BOOK_BOOK_CPP
+#define BOOK_BOOK_CPP
+
+/* What is a Polyglot book?
+ * A .bin file of 16 byte entries, sorted by key. All the numbers are big-endian.
+    * key: 8 bytes, the polyglot key of the position (see getPolyglotKey)
+    * move: 2 bytes. bits 0-2 to file, 3-5 to row, 6-8 from file, 9-11 from row, 12-14 promotion (1 = knight ... 4 = queen)
+    * weight: 2 bytes, how often the move should be played compared to the others in the position
+    * learn: 4 bytes, which we ignore
+ * There can be several entries for a position, one after the other.
+ * */
+#define BOOK_ENTRY_SIZE 16
+
+class OpeningBook {
+    const unsigned char *data = nullptr; // the file, mapped into memory
+    size_t fileSize = 0;
+    size_t numEntries = 0;
+    std::vector<unsigned char> fileBuffer; // on windows we just read the whole file in
+    PRNG rng;
+
+    static U64 readBigEndian(const unsigned char *bytes, int numBytes) {
+        U64 value = 0;
+        for (int i = 0; i < numBytes; i ++) value = (value << 8) | bytes[i];
+        return value;
+    }
+    Zobrist entryKey(size_t index) {return readBigEndian(data + index * BOOK_ENTRY_SIZE, 8);}
+    uint16_t entryMove(size_t index) {return readBigEndian(data + index * BOOK_ENTRY_SIZE + 8, 2);}
+    uint16_t entryWeight(size_t index) {return readBigEndian(data + index * BOOK_ENTRY_SIZE + 10, 2);}
+
+    size_t lowerBound(Zobrist key) {
+        // binary search for the first entry with a key that isn't less than the given one
+        size_t low = 0, high = numEntries;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (entryKey(mid) < key) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    Move decodeBookMove(uint16_t bookMove, SearchController &board) {
+        /* Turns a polyglot move into one of ours, by finding it in the legal move list.
+         * Polyglot castles as the king taking its own rook, which is how we encode castling too, so it needs no special case.
+         * */
+        short toFile = bookMove & 7, toRow = (bookMove >> 3) & 7;
+        short fromFile = (bookMove >> 6) & 7, fromRow = (bookMove >> 9) & 7;
+        short bookPromo = (bookMove >> 12) & 7;
+
+        short from = (7 - fromRow) * 8 + fromFile, to = (7 - toRow) * 8 + toFile; // our squares are flipped
+        const short promoCodes[5] = {0, KNIGHTPROMO, BISHOPPROMO, ROOKPROMO, QUEENPROMO};
+
+        for (Move move: board.getMoveList()) {
+            short f, t, promo, flag, fromType, toType;
+            decodeMove(move, f, t, promo, flag, fromType, toType);
+            if ((f != from) || (t != to)) continue;
+            if ((flag == PROMOTION) && (!bookPromo || promo != promoCodes[bookPromo])) continue;
+
+            return move;
+        }
+
+        return 0; // the book doesn't match our position e.g. a key collision
+    }
+
+public:
+    OpeningBook() {
+        rng.seed ^= std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+    ~OpeningBook() {close();}
+
+    bool open(const string &path) {
+        /* Maps the book into memory. We only touch the pages we binary search through, so opening a huge book is instant */
+        close();
+
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        fileBuffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        fileSize = fileBuffer.size();
+        data = fileBuffer.data();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat fileStats;
+        if ((fstat(fd, &fileStats) < 0) || (fileStats.st_size < BOOK_ENTRY_SIZE)) {
+            ::close(fd);
+            return false;
+        }
+        fileSize = fileStats.st_size;
+
+        void *mapped = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file open
+        if (mapped == MAP_FAILED) {
+            fileSize = 0;
+            return false;
+        }
+        data = (const unsigned char *) mapped;
+#endif
+
+        numEntries = fileSize / BOOK_ENTRY_SIZE;
+        return true;
+    }
+    void close() {
+#ifndef _WIN32
+        if (data) munmap((void *) data, fileSize);
+#endif
+        fileBuffer.clear();
+        data = nullptr;
+        fileSize = numEntries = 0;
+    }
+    bool isOpen() {return data != nullptr;}
+
+    Move probe(SearchController &board) {
+        /* Picks a book move for the position, or returns 0 if we're out of book.
+         * How does it work?
+         * 1. Binary search for the first entry of the position.
+         * 2. Add up the weights of all the entries of the position.
+         * 3. Pick a random number below the total, and play the move whose weight it lands in.
+         *    So a move with twice the weight is played twice as often.
+         * */
+        if (!isOpen()) return 0;
+
+        // * 1.
+        Zobrist key = board.getPolyglotKey();
+        size_t first = lowerBound(key);
+
+        // * 2.
+        U64 totalWeight = 0;
+        size_t last = first;
+        for (; (last < numEntries) && (entryKey(last) == key); last ++) {
+            totalWeight += entryWeight(last);
+        }
+        if (first == last) return 0;
+
+        // * 3.
+        if (totalWeight == 0) return decodeBookMove(entryMove(first), board); // all the moves are equally bad, so just play the first
+        U64 pick = rng.rand() % totalWeight;
+        for (size_t i = first; i < last; i ++) {
+            U64 weight = entryWeight(i);
+            if (pick < weight) return decodeBookMove(entryMove(i), board);
+            pick -= weight;
+        }
+
+        return 0;
+    }
+};
+
+#endif //BOOK_BOOK_CPP
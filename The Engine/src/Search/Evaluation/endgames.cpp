@@ -0,0 +1,199 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <vector>
+#include <algorithm>
+#include "../../Board/bitboards.cpp"
+#include "../Tablebases/syzygy.cpp"
+#include "evaluation.h"
+
+#ifndef EVALUATION_ENDGAMES_CPP
+#define EVALUATION_ENDGAMES_CPP
+
+/* Specialised endgame evaluators
+ * Some endgames are won (or drawn) whatever the generic evaluation thinks, and need a plan the search can't find on its own
+ * e.g. in KBNK the king has to be driven into a corner of the bishop's colour.
+ * The material table works out which (if any) evaluator a material signature uses, so there is no cost in other positions.
+ * The evaluators work on the position in a1 = 0 order (as for the tablebases), and score it relative to the strong side.
+ * */
+typedef int (*EndgameEvaluator)(const TBPosition &pos, Side strongSide);
+
+inline int squareFile(int sq) {return sq & 7;}
+inline int squareRank(int sq) {return sq >> 3;}
+inline int squareDistance(int a, int b) {
+    return std::max(abs(squareFile(a) - squareFile(b)), abs(squareRank(a) - squareRank(b)));
+}
+inline int centreDistance(int sq) {
+    // 0 in the centre, 6 in the corners
+    return std::max(3 - squareFile(sq), squareFile(sq) - 4) + std::max(3 - squareRank(sq), squareRank(sq) - 4);
+}
+inline int pushToEdge(int sq) {return 20 * centreDistance(sq);}
+inline int pushClose(int a, int b) {return 140 - 20 * squareDistance(a, b);}
+inline int lsbSquare(U64 BB) {return __builtin_ctzll(BB);}
+const U64 DarkSquaresA1 = 0xAA55AA55AA55AA55; // a1, c1, ..., b2, d2, ... in a1 = 0 order
+
+/* The KPK bitbase
+ * Every KPK position is classified as won or drawn for the side with the pawn, by retrograde analysis when the engine starts.
+ * The strong side is always white, and the pawn is always on files a-d (the board is mirrored to get there), which leaves 2 * 24 * 64 * 64 positions.
+ * How does it work?
+ * 1. Classify the positions we know straight away: illegal positions, the pawn promoting safely, and black stalemated or winning the pawn.
+ * 2. Go over the unknown positions again and again. With white to move, it's a win if any move reaches a win.
+ *    With black to move, it's a draw if any move reaches a draw. Stop once nothing changes.
+ * 3. Everything still unknown can't be won, so is a draw.
+ * */
+#define KPK_SIZE (2 * 24 * 64 * 64)
+enum KPKResult {KPK_INVALID = 0, KPK_UNKNOWN = 1, KPK_DRAW = 2, KPK_WIN = 4};
+uint32_t KPKBitbase[KPK_SIZE / 32]; // one bit per position, set if white wins
+
+inline int KPKIndex(int side, int blackKing, int whiteKing, int pawn) {
+    return side | (blackKing << 1) | (whiteKing << 7) | (squareFile(pawn) << 13) | ((6 - squareRank(pawn)) << 15);
+}
+inline bool KPKPawnAttacks(int pawn, int sq) {
+    return (squareRank(sq) == squareRank(pawn) + 1) && (abs(squareFile(sq) - squareFile(pawn)) == 1);
+}
+inline vector<int> KPKKingMoves(int sq) {
+    vector<int> moves;
+    for (int to = 0; to < 64; to ++) {
+        if (squareDistance(sq, to) == 1) moves.push_back(to);
+    }
+    return moves;
+}
+U8 KPKClassifyInitial(int side, int blackKing, int whiteKing, int pawn) {
+    if ((squareDistance(whiteKing, blackKing) <= 1) || (whiteKing == pawn) || (blackKing == pawn) ||
+        ((side == WHITE) && KPKPawnAttacks(pawn, blackKing))) return KPK_INVALID;
+
+    if (side == WHITE) {
+        // the pawn promotes, and the queen can't be taken
+        int promo = pawn + 8;
+        if ((squareRank(pawn) == 6) && (whiteKing != promo) && (blackKing != promo) &&
+            ((squareDistance(blackKing, promo) > 1) || (squareDistance(whiteKing, promo) == 1))) return KPK_WIN;
+    } else {
+        // black is stalemated, or takes an undefended pawn
+        bool canMove = false;
+        for (int to: KPKKingMoves(blackKing)) {
+            if ((squareDistance(to, whiteKing) > 1) && !KPKPawnAttacks(pawn, to)) canMove = true;
+        }
+        if (!canMove) return KPK_DRAW;
+        if ((squareDistance(blackKing, pawn) == 1) && (squareDistance(whiteKing, pawn) > 1)) return KPK_DRAW;
+    }
+
+    return KPK_UNKNOWN;
+}
+void initKPK() {
+    vector<U8> results(KPK_SIZE);
+
+    // * 1.
+    for (int index = 0; index < KPK_SIZE; index ++) {
+        int side = index & 1, blackKing = (index >> 1) & 63, whiteKing = (index >> 7) & 63;
+        int pawn = ((index >> 13) & 3) + 8 * (6 - ((index >> 15) & 7));
+        results[index] = KPKClassifyInitial(side, blackKing, whiteKing, pawn);
+    }
+
+    // * 2.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int index = 0; index < KPK_SIZE; index ++) {
+            if (results[index] != KPK_UNKNOWN) continue;
+
+            int side = index & 1, blackKing = (index >> 1) & 63, whiteKing = (index >> 7) & 63;
+            int pawn = ((index >> 13) & 3) + 8 * (6 - ((index >> 15) & 7));
+
+            U8 reached = 0; // the results of every move, or'd together. illegal moves reach an invalid position, so add nothing
+            if (side == WHITE) {
+                for (int to: KPKKingMoves(whiteKing)) reached |= results[KPKIndex(BLACK, blackKing, to, pawn)];
+
+                // pushes onto a king give an invalid position, and promotions were classified in step 1
+                if (squareRank(pawn) < 6) reached |= results[KPKIndex(BLACK, blackKing, whiteKing, pawn + 8)];
+                if ((squareRank(pawn) == 1) && (pawn + 8 != whiteKing) && (pawn + 8 != blackKing)) {
+                    reached |= results[KPKIndex(BLACK, blackKing, whiteKing, pawn + 16)];
+                }
+
+                results[index] = (reached & KPK_WIN) ? KPK_WIN : (reached & KPK_UNKNOWN) ? KPK_UNKNOWN : KPK_DRAW;
+            } else {
+                for (int to: KPKKingMoves(blackKing)) reached |= results[KPKIndex(WHITE, to, whiteKing, pawn)];
+
+                results[index] = (reached & KPK_DRAW) ? KPK_DRAW : (reached & KPK_UNKNOWN) ? KPK_UNKNOWN : KPK_WIN;
+            }
+            changed |= (results[index] != KPK_UNKNOWN);
+        }
+    }
+
+    // * 3.
+    std::fill(std::begin(KPKBitbase), std::end(KPKBitbase), 0);
+    for (int index = 0; index < KPK_SIZE; index ++) {
+        if (results[index] == KPK_WIN) KPKBitbase[index / 32] |= (1u << (index % 32));
+    }
+}
+bool probeKPK(int side, int blackKing, int whiteKing, int pawn) {
+    // returns whether white (with the pawn) wins. the squares are in a1 = 0 order
+    if (squareFile(pawn) > 3) {
+        // mirror onto files a-d
+        blackKing ^= 7;
+        whiteKing ^= 7;
+        pawn ^= 7;
+    }
+    int index = KPKIndex(side, blackKing, whiteKing, pawn);
+    return KPKBitbase[index / 32] & (1u << (index % 32));
+}
+
+/* The evaluators */
+int evaluateDraw(const TBPosition &, Side) {
+    // neither side has enough material to mate
+    return 0;
+}
+int evaluateKXK(const TBPosition &pos, Side strongSide) {
+    /* The weak side has a lone king. Drive it to the edge, and bring our king closer to help mate it.
+     * With a queen, rook, bishop and knight, or bishops on both colours, it's a known win, so scored above any normal evaluation.
+     * Bishops that are all on one colour can't mate, so without pawns it's a draw.
+     * */
+    Side weakSide = (strongSide == WHITE) ? BLACK : WHITE;
+    int strongKing = lsbSquare(pos.pieces[strongSide][KING]), weakKing = lsbSquare(pos.pieces[weakSide][KING]);
+
+    U64 bishops = pos.pieces[strongSide][BISHOP];
+    bool bothColours = (bishops & DarkSquaresA1) && (bishops & ~DarkSquaresA1);
+    bool mates = pos.pieces[strongSide][QUEEN] || pos.pieces[strongSide][ROOK] ||
+                 (bishops && pos.pieces[strongSide][KNIGHT]) || bothColours;
+    if (!mates && !pos.pieces[strongSide][PAWN]) return 0;
+
+    int score = 0;
+    for (short pc = PAWN; pc <= QUEEN; pc ++) score += PieceValues[EG][pc] * count(pos.pieces[strongSide][pc]);
+    score += pushToEdge(weakKing) + pushClose(strongKing, weakKing);
+
+    if (mates) score += KNOWN_WIN;
+
+    return score;
+}
+int evaluateKBNK(const TBPosition &pos, Side strongSide) {
+    /* Mate with bishop and knight can only be forced in a corner of the bishop's colour, so we drive the king there */
+    Side weakSide = (strongSide == WHITE) ? BLACK : WHITE;
+    int strongKing = lsbSquare(pos.pieces[strongSide][KING]), weakKing = lsbSquare(pos.pieces[weakSide][KING]);
+    int bishop = lsbSquare(pos.pieces[strongSide][BISHOP]);
+
+    // a1 is a dark square. for a light squared bishop, flip the board so it's the corners we want
+    if ((squareFile(bishop) + squareRank(bishop)) % 2) weakKing ^= 56;
+    int cornerDistance = std::min(squareDistance(weakKing, 0), squareDistance(weakKing, 63)); // a1 and h8
+
+    return KNOWN_WIN + PieceValues[EG][BISHOP] + PieceValues[EG][KNIGHT] + pushClose(strongKing, weakKing) + 40 * (7 - cornerDistance);
+}
+int evaluateKPK(const TBPosition &pos, Side strongSide) {
+    /* King and pawn against king is looked up in the bitbase. Wins are scored by how far the pawn has got */
+    Side weakSide = (strongSide == WHITE) ? BLACK : WHITE;
+    int strongKing = lsbSquare(pos.pieces[strongSide][KING]), weakKing = lsbSquare(pos.pieces[weakSide][KING]);
+    int pawn = lsbSquare(pos.pieces[strongSide][PAWN]);
+    int side = pos.side;
+
+    // the bitbase has the pawn as white's. if it's black's, flip the board and swap the sides
+    if (strongSide == BLACK) {
+        strongKing ^= 56;
+        weakKing ^= 56;
+        pawn ^= 56;
+        side ^= 1;
+    }
+
+    if (!probeKPK(side, weakKing, strongKing, pawn)) return 0;
+    return KNOWN_WIN + PieceValues[EG][PAWN] + 10 * squareRank(pawn);
+}
+
+#endif //EVALUATION_ENDGAMES_CPP
@@ -0,0 +1,53 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <atomic>
+#include "../Transposition Table/zobrist.h"
+
+#ifndef EVALUATION_EVALCACHE_CPP
+#define EVALUATION_EVALCACHE_CPP
+
+/* The eval cache
+ * The same positions are evaluated again and again, in each iteration of the search and through transpositions, so we keep the evaluations.
+ * It can be shared between threads without locks, as each entry is a single 64 bit word: the top 48 bits of the zobrist key, and the 16 bit evaluation.
+ * A torn read is impossible, so the worst that can happen is a lost write.
+ * */
+class EvalCache {
+    std::atomic<U64> *table; // like the TT, copies of a board share the table
+    long size; // a power of 2
+    long keyMask;
+
+public:
+    /* These stats keep track of the hit rate */
+    int totalProbeCalls = 0, totalProbeFound = 0;
+
+    EvalCache(int sizeMb) {
+        size = 1;
+        while (size * 2 * (long) sizeof(U64) <= std::max(sizeMb, 1) * (1L << 20)) size *= 2; // the largest power of 2 that fits
+        keyMask = size - 1;
+        table = new std::atomic<U64>[size];
+        clear();
+    }
+
+    inline bool probe(Zobrist key, int &eval) {
+        // looks up the evaluation for a zobrist key, and returns whether it was there
+        totalProbeCalls ++;
+
+        U64 entry = table[key & keyMask].load(std::memory_order_relaxed);
+        if (!entry || ((entry ^ key) >> 16)) return false;
+
+        totalProbeFound ++;
+        eval = (int16_t) (entry & 0xFFFF);
+        return true;
+    }
+    inline void store(Zobrist key, int eval) {
+        table[key & keyMask].store((key & ~0xFFFFULL) | (uint16_t) eval, std::memory_order_relaxed);
+    }
+    void clear() {
+        for (long i = 0; i < size; i ++) table[i].store(0, std::memory_order_relaxed);
+        totalProbeCalls = totalProbeFound = 0;
+    }
+};
+
+#endif //EVALUATION_EVALCACHE_CPP
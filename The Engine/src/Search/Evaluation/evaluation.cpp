@@ -6,52 +6,234 @@
 #include "evaluation.h"
 
 int SearchController::evaluate() {
-    /* Right now it just does piece worth's */
+    /* The same positions are evaluated again and again (in every iteration, and through transpositions), so the evaluations are cached */
+    int eval;
+    if (searchParameters->useEvalCache && evalCache->probe(zobristState, eval)) return eval;
 
-    /* negamax requires that the evaluation is relative to the current side */
-    //TODO THIS
-    return materialEvaluation * (currentSide == WHITE ? 1 : -1);
+    eval = staticEvaluation();
+    if (searchParameters->useEvalCache) evalCache->store(zobristState, eval);
+    return eval;
 }
 int SearchController::relativeLazy() {
-    /* Right now it just does piece worth's */
+    /* There is no lazy evaluation yet, so this is the full (cached) evaluation */
+    return evaluate();
+}
+int SearchController::staticEvaluation() {
+    /* The network if we have one, otherwise the handcrafted evaluation */
+    if (NNUE.loaded && searchParameters->useNNUE) return evaluateNNUE();
 
     /* negamax requires that the evaluation is relative to the current side */
-    return materialEvaluation * (currentSide == WHITE ? 1 : -1);
+    return taperedEvaluation() * (currentSide == WHITE ? 1 : -1);
 }
-int SearchController::biasedMaterial() {
-    /* this evaluation function is relative to white */
+int SearchController::taperedEvaluation() {
+    /* Blends the middlegame and endgame evaluations by the game phase. This is relative to white
+     * With all the pieces on the board it's just the middlegame score, and with just kings and pawns it's just the endgame score.
+     * */
+    MaterialEntry *material = probeMaterial();
+
+    // endgames we know how to play have their own evaluation
+    if (material->evaluator) {
+        int score = material->evaluator(getTBPosition(), material->strongSide);
+        return score * (material->strongSide == WHITE ? 1 : -1);
+    }
 
-    int eval = 0;
+    int eval[2] = {materialEvaluation[MG] + material->imbalance[MG], materialEvaluation[EG] + material->imbalance[EG]};
+    evaluatePawns(eval);
+
+    // drawish endgames are scaled down for the side that's ahead
+    eval[EG] = eval[EG] * material->scaleFactor[eval[EG] > 0 ? WHITE : BLACK] / SCALE_NORMAL;
+
+    int phase = std::min(gamePhase, TOTAL_PHASE); // promotions can take the phase over the starting one
+    return (eval[MG] * phase + eval[EG] * (TOTAL_PHASE - phase)) / TOTAL_PHASE;
+}
+MaterialEntry* SearchController::probeMaterial() {
+    // returns the material table entry for the position, filling it in if it isn't there
+    bool found;
+    MaterialEntry *entry = materialTable.probe(materialZobristState, found);
+    if (!found) {
+        int counts[2][6];
+        for (Side side: {WHITE, BLACK}) {
+            for (short pc = PAWN; pc <= KING; pc ++) counts[side][pc] = count(getPieces(pc, side));
+        }
+        computeMaterialEntry(*entry, counts);
+        entry->key = materialZobristState;
+    }
+    return entry;
+}
+void SearchController::evaluatePawns(int *eval) {
+    /* Adds the pawn evaluation (relative to white) to the middlegame and endgame evaluations.
+     * The pawn structure is looked up in the pawn table, and only evaluated if it isn't there.
+     * The shield depends on the kings as well, so it's always evaluated.
+     * */
+    if (searchParameters->usePawnTable) {
+        bool found;
+        PawnEntry *entry = pawnTable.probe(pawnZobristState, found);
+        if (!found) {
+            int structure[2] = {0, 0};
+            evaluatePawnStructure(structure);
+            entry->key = pawnZobristState;
+            entry->eval[MG] = structure[MG];
+            entry->eval[EG] = structure[EG];
+        }
+        eval[MG] += entry->eval[MG];
+        eval[EG] += entry->eval[EG];
+    } else {
+        evaluatePawnStructure(eval);
+    }
 
-    /* Start with knights */
-    U64 wKnights = getPieces(KNIGHT, WHITE), bKnights = getPieces(KNIGHT, BLACK);
-    eval += PieceScores[KNIGHT] * (count(wKnights) - count(bKnights));
+    evaluatePawnShield(eval);
+}
+void SearchController::evaluatePawnStructure(int *eval) {
+    /* Evaluates the pawn structure with bitboard fills, so each term is worked out for every pawn at once.
+     * How does it work? For each side:
+     * 1. Passed pawns have no enemy pawns in front of them, on their file or the files next to it.
+     *    So we fill the enemy pawns forwards (from the enemy's point of view) and spread them to the neighbouring files.
+     * 2. Doubled pawns have a friendly pawn behind them, so only the front pawns are counted.
+     * 3. Isolated pawns have no friendly pawns on the files next to them.
+     * 4. Backward pawns have their stop square attacked by an enemy pawn, and no friendly pawn can ever advance to defend it.
+     * */
+    for (Side side: {WHITE, BLACK}) {
+        Side enemy = (side == WHITE) ? BLACK : WHITE;
+        int sign = (side == WHITE ? 1 : -1);
+        U64 pawns = getPieces(PAWN, side), enemyPawns = getPieces(PAWN, enemy);
 
-    /* Now bishops */
-    U64 wBishops = getPieces(BISHOP, WHITE), bBishops = getPieces(BISHOP, BLACK);
-    eval += PieceScores[BISHOP] * (count(wBishops) - count(bBishops));
+        // * 1.
+        U64 enemySpans = push(forwardFill(enemyPawns, enemy), enemy);
+        U64 behindPawns = push(forwardFill(pawns, enemy), enemy); // only the front pawn of doubled pawns is passed
+        U64 passed = pawns & ~(enemySpans | adjacentFiles(enemySpans) | behindPawns);
+        while (passed) {
+            short sq = popIntLSB(passed);
+            short rank = (side == WHITE) ? 7 - sq / 8 : sq / 8; // relative to the side's back rank
+            eval[MG] += PassedPawnBonus[MG][rank] * sign;
+            eval[EG] += PassedPawnBonus[EG][rank] * sign;
+        }
 
-    /* Now rooks */
-    U64 wRooks = getPieces(ROOK, WHITE), bRooks = getPieces(ROOK, BLACK);
-    eval += PieceScores[ROOK] * (count(wRooks) - count(bRooks));
+        // * 2.
+        short doubled = count(pawns & push(forwardFill(pawns, side), side));
+        eval[MG] += DoubledPawnPenalty[MG] * doubled * sign;
+        eval[EG] += DoubledPawnPenalty[EG] * doubled * sign;
 
-    /* Now queen */
-    U64 wQueen = getPieces(QUEEN, WHITE), bQueen = getPieces(QUEEN, BLACK);
-    eval += PieceScores[QUEEN] * (count(wQueen) - count(bQueen));
+        // * 3.
+        U64 isolatedPawns = pawns & ~adjacentFiles(fileFill(pawns));
+        short isolated = count(isolatedPawns);
+        eval[MG] += IsolatedPawnPenalty[MG] * isolated * sign;
+        eval[EG] += IsolatedPawnPenalty[EG] * isolated * sign;
 
-    /* Now pawns */
-    U64 wPawns = getPieces(PAWN, WHITE), bPawns = getPieces(PAWN, BLACK);
-    eval += PieceScores[PAWN] * (count(wPawns) - count(bPawns));
+        // * 4.
+        U64 defendable = forwardFill(pawnAttacks(pawns, side), side); // every square our pawns could defend by advancing
+        U64 backwardStops = push(pawns, side) & pawnAttacks(enemyPawns, enemy) & ~defendable;
+        short backward = count(push(backwardStops, enemy) & ~isolatedPawns); // isolated pawns are already penalised
+        eval[MG] += BackwardPawnPenalty[MG] * backward * sign;
+        eval[EG] += BackwardPawnPenalty[EG] * backward * sign;
+    }
+}
+void SearchController::evaluatePawnShield(int *eval) {
+    /* Rewards pawns on the king's file and the files next to it, one or two ranks in front of the king.
+     * It's only a middlegame term, as in the endgame the king should come out.
+     * */
+    for (Side side: {WHITE, BLACK}) {
+        U64 king = getPieces(KING, side), pawns = getPieces(PAWN, side);
+        U64 front = push(king | adjacentFiles(king), side);
+
+        eval[MG] += (PawnShieldBonus[0] * count(front & pawns) + PawnShieldBonus[1] * count(push(front, side) & pawns)) * (side == WHITE ? 1 : -1);
+    }
+}
+void SearchController::calculateEvaluation() {
+    /* Recalculates the material evaluation (relative to white) and game phase from scratch.
+     * After this they're kept up to date incrementally by updateAfterMove.
+     * */
+    materialEvaluation[MG] = materialEvaluation[EG] = 0;
+    gamePhase = 0;
 
-    /* do PST */
     for (Pieces piece: {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING}) {
         for (Side side: {WHITE, BLACK}) {
-            eval += dotProduct(getPieces(piece, side), PST[piece][side]) * (side == WHITE ? 1 : -1);
+            U64 pieces = getPieces(piece, side);
+            int sign = (side == WHITE ? 1 : -1);
+
+            /* material */
+            materialEvaluation[MG] += PieceValues[MG][piece] * count(pieces) * sign;
+            materialEvaluation[EG] += PieceValues[EG][piece] * count(pieces) * sign;
+            gamePhase += PhaseWeights[piece] * count(pieces);
+
+            /* do PST */
+            materialEvaluation[MG] += dotProduct(pieces, PST[MG][piece][side]) * sign;
+            materialEvaluation[EG] += dotProduct(pieces, PST[EG][piece][side]) * sign;
         }
     }
+}
+int SearchController::evaluateNNUE() {
+    // brings both accumulators up to date, and runs the network. it's relative to the current side
+    if (accumulators.empty()) {
+        accumulators.resize(MAX_GAME_LENGTH); // the first time the network is used. none of them are computed yet
+        accumulatorGeneration = NNUEGeneration;
+    } else if (accumulatorGeneration != NNUEGeneration) {
+        // a network has been loaded since the accumulators were computed, so none of them can be used
+        for (NNUEAccumulator &accumulator: accumulators) accumulator.computed[WHITE] = accumulator.computed[BLACK] = false;
+        accumulatorGeneration = NNUEGeneration;
+    }
 
-    //TODO add in endgame king stuff
+    updateAccumulator(WHITE);
+    updateAccumulator(BLACK);
+    return NNUEForward(accumulators[moveNumber], currentSide);
+}
+void SearchController::refreshAccumulator(short perspective) {
+    // computes one perspective of the current accumulator from scratch
+    NNUEAccumulator &accumulator = accumulators[moveNumber];
+    TBPosition pos = getTBPosition(); // the network wants the squares in a1 = 0 order, like the tablebases
+    short kingSquare = __builtin_ctzll(pos.pieces[perspective][KING]);
 
-    /* negamax requires that the evaluation is relative to the current side */
-    return eval;
+    std::copy(NNUE.featureBiases.begin(), NNUE.featureBiases.end(), accumulator.values[perspective]);
+    for (short side: {WHITE, BLACK}) {
+        for (short pc = PAWN; pc <= QUEEN; pc ++) {
+            U64 pieces = pos.pieces[side][pc];
+            while (pieces) {
+                short sq = popIntLSB(pieces);
+                NNUEAddFeature(accumulator.values[perspective], NNUEFeature(perspective, kingSquare, pc, side, sq));
+            }
+        }
+    }
+    accumulator.computed[perspective] = true;
+}
+void SearchController::updateAccumulator(short perspective) {
+    /* Brings one perspective of the current accumulator up to date.
+     * How does it work?
+     * 1. Walk back through the stack to the last position with a computed accumulator.
+     *    If we reach the start of the stack, or a move of this perspective's king (which changes every feature), refresh from scratch instead.
+     * 2. Walk forwards again, adding and subtracting the features of the pieces each move changed.
+     * */
+    if (accumulators[moveNumber].computed[perspective]) return;
+
+    // * 1.
+    short n = moveNumber;
+    while (!accumulators[n].computed[perspective]) {
+        bool kingMoved = false;
+        for (int i = 0; (n > 1) && (i < stack[n - 1].numChanges); i ++) {
+            const PieceChange &change = stack[n - 1].changes[i];
+            kingMoved |= (change.piece == KING) && (change.side == perspective);
+        }
+        if ((n == 1) || kingMoved) {
+            refreshAccumulator(perspective);
+            return;
+        }
+        n --;
+    }
+
+    // * 2.
+    short kingSquare = __builtin_ctzll(getPieces(KING, perspective)) ^ 56; // it hasn't moved since n
+    for (; n < moveNumber; n ++) {
+        int16_t *values = accumulators[n + 1].values[perspective];
+        std::copy(accumulators[n].values[perspective], accumulators[n].values[perspective] + NNUE_HIDDEN, values);
+
+        for (int i = 0; i < stack[n].numChanges; i ++) {
+            const PieceChange &change = stack[n].changes[i];
+            if (change.piece == KING) continue; // kings aren't features
+            int feature = NNUEFeature(perspective, kingSquare, change.piece, change.side, change.square ^ 56);
+            if (change.sign > 0) {
+                NNUEAddFeature(values, feature);
+            } else {
+                NNUESubFeature(values, feature);
+            }
+        }
+        accumulators[n + 1].computed[perspective] = true;
+    }
 }
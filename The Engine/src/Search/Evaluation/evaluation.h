@@ -8,14 +8,37 @@
 #include "../../types.h"
 
 
-// worths of all the pieces for each side
+/* Tapered evaluation
+ * Everything is scored twice, once for the middlegame (MG) and once for the endgame (EG).
+ * The game phase counts the non-pawn material left, and the two scores are blended by it at eval time.
+ * e.g. the king should hide in the middlegame, but come out and fight in the endgame.
+ * */
+enum GamePhase {MG, EG};
+const int PhaseWeights[7] = {0, 1, 1, 2, 4, 0, 0}; // how much each piece counts towards the game phase
+#define TOTAL_PHASE 24 // the phase of the starting position
+#define KNOWN_WIN 10000 // added to the evaluation of endgames we know are won. it's still well below the tablebase and mate scores
+
+// worths of all the pieces, used by SEE and move ordering
 const int PieceScores[7] = {100, 300, 300, 500, 900, 0, 0}; // one extra for empty pieces
-const int PieceWorths[12] = {100, 300, 300, 500, 900, 0, -100, -300, -300, -500, -900, 0}; // holds the worth for all pieces
+const int PieceValues[2][7] = {{100, 300, 300, 500, 900, 0, 0}, // middlegame
+                               {120, 290, 310, 530, 950, 0, 0}}; // endgame. pawns become more valuable, and rooks and bishops like the open board
+
+/* Pawn structure. each is {middlegame, endgame}
+ * Passed pawns are indexed by their rank, counted from the side's own back rank.
+ * */
+const int PassedPawnBonus[2][8] = {{0, 5, 10, 15, 25, 40, 60, 0},
+                                   {0, 10, 15, 25, 45, 70, 100, 0}};
+const int DoubledPawnPenalty[2] = {-10, -20}; // for each pawn with a friendly pawn behind it
+const int IsolatedPawnPenalty[2] = {-10, -15}; // no friendly pawns on the files next to it
+const int BackwardPawnPenalty[2] = {-8, -10}; // it can't advance safely, and its neighbours are too far forward to support it
+const int PawnShieldBonus[2] = {10, 5}; // middlegame only. for each pawn one/ two ranks in front of the king
 
 /* Piece Square Tables
- * Two sides, six pieces, 64 squares.
+ * Two phases, six pieces, two sides, 64 squares.
  * */
-const Byte PST[6][2][64] = {
+const Byte PST[2][6][2][64] = {
+        /* middlegame */
+        {
         // pawns
         {{0,  0,  0,  0,  0,  0,  0,  0,
           50, 50, 50, 50, 50, 50, 50, 50,
@@ -115,6 +138,112 @@ const Byte PST[6][2][64] = {
                                                    -30, -40, -40, -50, -50, -40, -40, -30,
                                                    -30, -40, -40, -50, -50, -40, -40, -30,
                                                    -30, -40, -40, -50, -50, -40, -40, -30}}
+        },
+        /* endgame */
+        {
+        // pawns
+        {{  0,   0,   0,   0,   0,   0,   0,   0,
+            80,  80,  80,  80,  80,  80,  80,  80,
+            50,  50,  50,  50,  50,  50,  50,  50,
+            30,  30,  30,  30,  30,  30,  30,  30,
+            15,  15,  15,  15,  15,  15,  15,  15,
+             5,   5,   5,   5,   5,   5,   5,   5,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0},
+         {  0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             5,   5,   5,   5,   5,   5,   5,   5,
+            15,  15,  15,  15,  15,  15,  15,  15,
+            30,  30,  30,  30,  30,  30,  30,  30,
+            50,  50,  50,  50,  50,  50,  50,  50,
+            80,  80,  80,  80,  80,  80,  80,  80,
+             0,   0,   0,   0,   0,   0,   0,   0}},
+        // knights
+        {{-50, -40, -30, -30, -30, -30, -40, -50,
+           -40, -20, -10,  -5,  -5, -10, -20, -40,
+           -30, -10,   5,  10,  10,   5, -10, -30,
+           -30,  -5,  10,  15,  15,  10,  -5, -30,
+           -30,  -5,  10,  15,  15,  10,  -5, -30,
+           -30, -10,   5,  10,  10,   5, -10, -30,
+           -40, -20, -10,  -5,  -5, -10, -20, -40,
+           -50, -40, -30, -30, -30, -30, -40, -50},
+         {-50, -40, -30, -30, -30, -30, -40, -50,
+           -40, -20, -10,  -5,  -5, -10, -20, -40,
+           -30, -10,   5,  10,  10,   5, -10, -30,
+           -30,  -5,  10,  15,  15,  10,  -5, -30,
+           -30,  -5,  10,  15,  15,  10,  -5, -30,
+           -30, -10,   5,  10,  10,   5, -10, -30,
+           -40, -20, -10,  -5,  -5, -10, -20, -40,
+           -50, -40, -30, -30, -30, -30, -40, -50}},
+        // bishops
+        {{-20, -10, -10, -10, -10, -10, -10, -20,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+           -10,   0,   5,  10,  10,   5,   0, -10,
+           -10,   0,   5,  10,  10,   5,   0, -10,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -20, -10, -10, -10, -10, -10, -10, -20},
+         {-20, -10, -10, -10, -10, -10, -10, -20,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+           -10,   0,   5,  10,  10,   5,   0, -10,
+           -10,   0,   5,  10,  10,   5,   0, -10,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -20, -10, -10, -10, -10, -10, -10, -20}},
+        // rooks
+        {{  0,   0,   0,   0,   0,   0,   0,   0,
+            10,  10,  10,  10,  10,  10,  10,  10,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0},
+         {  0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0,
+            10,  10,  10,  10,  10,  10,  10,  10,
+             0,   0,   0,   0,   0,   0,   0,   0}},
+        // queens
+        {{-20, -10, -10,  -5,  -5, -10, -10, -20,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+            -5,   0,   5,  10,  10,   5,   0,  -5,
+            -5,   0,   5,  10,  10,   5,   0,  -5,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -20, -10, -10,  -5,  -5, -10, -10, -20},
+         {-20, -10, -10,  -5,  -5, -10, -10, -20,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+            -5,   0,   5,  10,  10,   5,   0,  -5,
+            -5,   0,   5,  10,  10,   5,   0,  -5,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -20, -10, -10,  -5,  -5, -10, -10, -20}},
+        // kings
+        {{-50, -40, -30, -20, -20, -30, -40, -50,
+           -30, -20, -10,   0,   0, -10, -20, -30,
+           -30, -10,  20,  30,  30,  20, -10, -30,
+           -30, -10,  30,  40,  40,  30, -10, -30,
+           -30, -10,  30,  40,  40,  30, -10, -30,
+           -30, -10,  20,  30,  30,  20, -10, -30,
+           -30, -30,   0,   0,   0,   0, -30, -30,
+           -50, -30, -30, -30, -30, -30, -30, -50},
+         {-50, -30, -30, -30, -30, -30, -30, -50,
+           -30, -30,   0,   0,   0,   0, -30, -30,
+           -30, -10,  20,  30,  30,  20, -10, -30,
+           -30, -10,  30,  40,  40,  30, -10, -30,
+           -30, -10,  30,  40,  40,  30, -10, -30,
+           -30, -10,  20,  30,  30,  20, -10, -30,
+           -30, -20, -10,   0,   0, -10, -20, -30,
+           -50, -40, -30, -20, -20, -30, -40, -50}}
+        }
 };
 
 
@@ -0,0 +1,127 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <vector>
+#include "../Transposition Table/zobrist.h"
+#include "endgames.cpp"
+
+#ifndef EVALUATION_MATERIAL_CPP
+#define EVALUATION_MATERIAL_CPP
+
+/* The material table
+ * Everything that only depends on how many of each piece there are is worked out once per material signature, and cached here.
+ * It's indexed by the material zobrist hash, which only changes on captures and promotions, so nearly every probe hits.
+ * */
+#define MATERIAL_TABLE_SIZE 8192 // the number of entries. must be a power of 2
+#define SCALE_NORMAL 64 // the endgame evaluation is multiplied by scaleFactor / SCALE_NORMAL
+
+struct MaterialEntry {
+    Zobrist key = 0; // the full material hash, to check for collisions
+    int16_t imbalance[2] = {0, 0}; // the middlegame and endgame imbalance, relative to white
+    U8 scaleFactor[2] = {SCALE_NORMAL, SCALE_NORMAL}; // scales the endgame evaluation when white/ black is ahead, for drawish endgames
+    EndgameEvaluator evaluator = nullptr; // replaces the whole evaluation, for endgames we know how to play
+    Side strongSide = WHITE; // the side the evaluator is for
+};
+
+/* Imbalance terms. each is {middlegame, endgame} */
+const int BishopPairBonus[2] = {30, 50};
+const int KnightPawnAdjustment[2] = {4, 4}; // for each of our pawns above 5. knights get better in closed positions
+const int RookPawnAdjustment[2] = {-8, -8}; // for each of our pawns above 5. rooks get worse in closed positions
+
+void computeMaterialEntry(MaterialEntry &entry, const int counts[2][6]) {
+    /* Fills in the entry for a material signature. counts is [side][piece]
+     * How does it work?
+     * 1. If one side has a lone king, look for an evaluator that knows the endgame (or if the other side can't force mate, it's a draw).
+     * 2. Add up the imbalance terms.
+     * 3. If the side that is ahead has few pawns and not much more material, it will struggle to win, so its endgame evaluation is scaled down.
+     * */
+    entry.imbalance[MG] = entry.imbalance[EG] = 0;
+    entry.evaluator = nullptr;
+    entry.strongSide = WHITE;
+
+    int nonPawnMaterial[2] = {0, 0};
+    for (Side side: {WHITE, BLACK}) {
+        for (short pc = KNIGHT; pc <= QUEEN; pc ++) nonPawnMaterial[side] += PieceScores[pc] * counts[side][pc];
+    }
+
+    // * 1.
+    for (Side side: {WHITE, BLACK}) {
+        Side weak = (side == WHITE) ? BLACK : WHITE;
+        if (nonPawnMaterial[weak] || counts[weak][PAWN]) continue;
+
+        // the pieces that can force mate on their own. two bishops need to be on different colours, which the evaluator checks
+        bool matingMaterial = counts[side][QUEEN] || counts[side][ROOK] || (counts[side][BISHOP] && counts[side][KNIGHT]) || (counts[side][BISHOP] >= 2);
+
+        if (!counts[side][PAWN] && (counts[side][BISHOP] == 1) && (counts[side][KNIGHT] == 1) &&
+            (nonPawnMaterial[side] == PieceScores[BISHOP] + PieceScores[KNIGHT])) {
+            entry.evaluator = &evaluateKBNK;
+        } else if (!nonPawnMaterial[side] && (counts[side][PAWN] == 1)) {
+            entry.evaluator = &evaluateKPK;
+        } else if (matingMaterial) {
+            entry.evaluator = &evaluateKXK;
+        } else if (!counts[side][PAWN] && !counts[side][BISHOP] && (counts[side][KNIGHT] <= 2)) {
+            entry.evaluator = &evaluateDraw; // one or two knights (or nothing at all) can't force mate
+        } else if (!counts[side][PAWN] && !counts[side][KNIGHT] && (counts[side][BISHOP] <= 1)) {
+            entry.evaluator = &evaluateDraw; // nor can a lone bishop
+        }
+
+        if (entry.evaluator) {
+            entry.strongSide = side;
+            return;
+        }
+    }
+
+    // * 2.
+    for (Side side: {WHITE, BLACK}) {
+        int sign = (side == WHITE ? 1 : -1);
+        int extraPawns = counts[side][PAWN] - 5;
+        for (int phase: {MG, EG}) {
+            int imbalance = (counts[side][BISHOP] >= 2) * BishopPairBonus[phase]
+                          + counts[side][KNIGHT] * extraPawns * KnightPawnAdjustment[phase]
+                          + counts[side][ROOK] * extraPawns * RookPawnAdjustment[phase];
+            entry.imbalance[phase] += imbalance * sign;
+        }
+    }
+
+    // * 3.
+    for (Side side: {WHITE, BLACK}) {
+        Side weak = (side == WHITE) ? BLACK : WHITE;
+        entry.scaleFactor[side] = SCALE_NORMAL;
+        if (nonPawnMaterial[side] - nonPawnMaterial[weak] > PieceScores[BISHOP]) continue;
+
+        if (!counts[side][PAWN]) {
+            // e.g. KNK and KNNK can't be won, and KRKB and KRKN rarely are
+            entry.scaleFactor[side] = (nonPawnMaterial[side] < PieceScores[ROOK]) ? 0 : (nonPawnMaterial[weak] <= PieceScores[BISHOP]) ? 4 : 14;
+        } else if (counts[side][PAWN] == 1) {
+            entry.scaleFactor[side] = 48;
+        }
+    }
+}
+
+class MaterialTable {
+    std::vector<MaterialEntry> table;
+
+public:
+    /* These stats keep track of the hit rate */
+    int totalProbeCalls = 0, totalProbeFound = 0;
+
+    MaterialTable(): table(MATERIAL_TABLE_SIZE) {}
+
+    inline MaterialEntry* probe(Zobrist key, bool &found) {
+        // returns the entry for a material hash, and whether it holds this material signature
+        totalProbeCalls ++;
+
+        MaterialEntry *entry = &table[key & (MATERIAL_TABLE_SIZE - 1)];
+        found = (entry->key == key);
+        totalProbeFound += found;
+
+        return entry;
+    }
+    void clear() {
+        std::fill(table.begin(), table.end(), MaterialEntry());
+        totalProbeCalls = totalProbeFound = 0;
+    }
+};
+
+#endif //EVALUATION_MATERIAL_CPP
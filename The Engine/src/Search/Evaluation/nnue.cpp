@@ -0,0 +1,139 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include "../../types.h"
+#include "simd.cpp"
+
+#ifndef EVALUATION_NNUE_CPP
+#define EVALUATION_NNUE_CPP
+
+/* What is NNUE?
+ * An efficiently updatable neural network. The first layer is huge, but a move only changes a few of its inputs,
+ * so instead of recomputing it we keep its output (the accumulator) and add/ subtract the weights of the inputs that changed.
+ * The rest of the network is small, so it's cheap to run at every evaluation.
+ *
+ * The inputs are HalfKP features: for each side (the perspective), one input for every (own king square, piece, square) combination.
+ * Kings aren't pieces here, so when a king moves every feature of its perspective changes, and the accumulator is refreshed from scratch.
+ *
+ * The network is 41024 -> 256 (for each perspective) -> 32 -> 32 -> 1, in integers:
+    * the accumulator is int16. the side to move's half goes first, and it's clipped to [0, 127] before the next layer
+    * the hidden layers have int8 weights and int32 biases. their outputs are shifted down by NNUE_WEIGHT_SHIFT and clipped to [0, 127]
+    * the output is divided by NNUE_OUTPUT_SCALE, and converted from the network's pawn value to ours
+ *
+ * The file is laid out like the first Stockfish networks (halfkp_256x2-32-32). Everything is little-endian:
+    * uint32 version, uint32 hash, uint32 description length, the description
+    * uint32 hash, then the feature transformer: int16 biases[256], int16 weights[41024][256]
+    * uint32 hash, then each hidden/ output layer: int32 biases[outputs], int8 weights[outputs][inputs]
+ * */
+#define NNUE_VERSION 0x7AF32F16
+#define NNUE_PIECE_SQUARES 641 // 10 pieces * 64 squares, plus one unused input
+#define NNUE_INPUTS (64 * NNUE_PIECE_SQUARES)
+#define NNUE_HIDDEN 256 // the accumulator size, for each perspective
+#define NNUE_L1 32
+#define NNUE_L2 32
+#define NNUE_WEIGHT_SHIFT 6
+#define NNUE_OUTPUT_SCALE 16
+#define NNUE_PAWN_VALUE 208 // what the network thinks a pawn is worth
+
+struct NNUENetwork {
+    bool loaded = false;
+
+    std::vector<int16_t> featureBiases, featureWeights; // [NNUE_HIDDEN], [NNUE_INPUTS][NNUE_HIDDEN]
+    std::vector<int32_t> L1Biases, L2Biases, outputBias; // [NNUE_L1], [NNUE_L2], [1]
+    std::vector<int8_t> L1Weights, L2Weights, outputWeights; // [NNUE_L1][2 * NNUE_HIDDEN], [NNUE_L2][NNUE_L1], [NNUE_L2]
+};
+NNUENetwork NNUE; // shared by every board. it's only written when a network is loaded, between searches
+int NNUEGeneration = 0; // bumped whenever a network is loaded, so boards know their accumulators are out of date
+
+/* The accumulator for one position. Each perspective is only computed when it's needed */
+struct alignas(64) NNUEAccumulator {
+    int16_t values[2][NNUE_HIDDEN];
+    bool computed[2] = {false, false};
+};
+
+template <typename T>
+bool readNNUEValues(FILE *file, std::vector<T> &values, size_t size) {
+    values.resize(size);
+    return fread(values.data(), sizeof(T), size, file) == size;
+}
+bool loadNNUE(const string &path) {
+    /* Loads a network from a file. If it fails, the previous network (if any) is thrown away, and the handcrafted evaluation is used */
+    NNUE = NNUENetwork();
+    NNUEGeneration ++;
+    if (path.empty()) return false;
+
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    uint32_t version, hash, descriptionLength;
+    bool ok = (fread(&version, 4, 1, file) == 1) && (version == NNUE_VERSION) &&
+              (fread(&hash, 4, 1, file) == 1) && (fread(&descriptionLength, 4, 1, file) == 1) &&
+              (fseek(file, descriptionLength, SEEK_CUR) == 0);
+
+    // the feature transformer
+    ok = ok && (fread(&hash, 4, 1, file) == 1) &&
+         readNNUEValues(file, NNUE.featureBiases, NNUE_HIDDEN) &&
+         readNNUEValues(file, NNUE.featureWeights, (size_t) NNUE_INPUTS * NNUE_HIDDEN);
+
+    // the rest of the network
+    ok = ok && (fread(&hash, 4, 1, file) == 1) &&
+         readNNUEValues(file, NNUE.L1Biases, NNUE_L1) && readNNUEValues(file, NNUE.L1Weights, NNUE_L1 * 2 * NNUE_HIDDEN) &&
+         readNNUEValues(file, NNUE.L2Biases, NNUE_L2) && readNNUEValues(file, NNUE.L2Weights, NNUE_L2 * NNUE_L1) &&
+         readNNUEValues(file, NNUE.outputBias, 1) && readNNUEValues(file, NNUE.outputWeights, NNUE_L2);
+
+    // the file should end exactly here, otherwise it's a different architecture
+    ok = ok && (fgetc(file) == EOF);
+    fclose(file);
+
+    if (!ok) {
+        NNUE = NNUENetwork();
+        return false;
+    }
+    NNUE.loaded = true;
+
+    selectNNUEKernels();
+    return true;
+}
+
+inline int NNUEFeature(short perspective, short kingSquare, short piece, short side, short square) {
+    /* The index of a feature. The squares are in a1 = 0 order, and black's perspective rotates the board so its pieces look like white's.
+     * The pieces go own pawn, enemy pawn, own knight, ..., enemy queen.
+     * */
+    if (perspective == BLACK) {
+        kingSquare ^= 63;
+        square ^= 63;
+    }
+    return kingSquare * NNUE_PIECE_SQUARES + 1 + (2 * piece + (side != perspective)) * 64 + square;
+}
+inline void NNUEAddFeature(int16_t *values, int feature) {
+    NNUEKernels.addWeights(values, &NNUE.featureWeights[(size_t) feature * NNUE_HIDDEN], NNUE_HIDDEN);
+}
+inline void NNUESubFeature(int16_t *values, int feature) {
+    NNUEKernels.subWeights(values, &NNUE.featureWeights[(size_t) feature * NNUE_HIDDEN], NNUE_HIDDEN);
+}
+
+int NNUEForward(const NNUEAccumulator &accumulator, short side) {
+    /* Runs the network after the accumulator, and returns the evaluation relative to the side to move */
+    alignas(64) uint8_t input[2 * NNUE_HIDDEN];
+    NNUEKernels.clipAccumulator(accumulator.values[side], input, NNUE_HIDDEN);
+    NNUEKernels.clipAccumulator(accumulator.values[!side], input + NNUE_HIDDEN, NNUE_HIDDEN);
+
+    alignas(64) int32_t L1Out[NNUE_L1], L2Out[NNUE_L2];
+    alignas(64) uint8_t L1Input[NNUE_L1], L2Input[NNUE_L2];
+    int32_t output;
+
+    NNUEKernels.affine(input, 2 * NNUE_HIDDEN, NNUE.L1Weights.data(), NNUE.L1Biases.data(), L1Out, NNUE_L1);
+    NNUEKernels.clippedReLU(L1Out, L1Input, NNUE_L1, NNUE_WEIGHT_SHIFT);
+    NNUEKernels.affine(L1Input, NNUE_L1, NNUE.L2Weights.data(), NNUE.L2Biases.data(), L2Out, NNUE_L2);
+    NNUEKernels.clippedReLU(L2Out, L2Input, NNUE_L2, NNUE_WEIGHT_SHIFT);
+    NNUEKernels.affine(L2Input, NNUE_L2, NNUE.outputWeights.data(), NNUE.outputBias.data(), &output, 1);
+
+    return output / NNUE_OUTPUT_SCALE * 100 / NNUE_PAWN_VALUE;
+}
+
+#endif //EVALUATION_NNUE_CPP
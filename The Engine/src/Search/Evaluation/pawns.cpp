@@ -0,0 +1,76 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <vector>
+#include "../../Board/bitboards.cpp"
+#include "../Transposition Table/zobrist.h"
+
+#ifndef EVALUATION_PAWNS_CPP
+#define EVALUATION_PAWNS_CPP
+
+/*
+ * These functions fill a bitboard forwards/ backwards, so every square in front of (or behind) a piece is set.
+ * */
+inline U64 northFill(U64 BB) {
+    BB |= BB >> 8;
+    BB |= BB >> 16;
+    BB |= BB >> 32;
+    return BB;
+}
+inline U64 southFill(U64 BB) {
+    BB |= BB << 8;
+    BB |= BB << 16;
+    BB |= BB << 32;
+    return BB;
+}
+inline U64 forwardFill(U64 BB, short side) {
+    return side == WHITE ? northFill(BB) : southFill(BB);
+}
+inline U64 fileFill(U64 BB) {
+    return northFill(BB) | southFill(BB);
+}
+inline U64 pawnAttacks(U64 pawns, short side) {
+    return side == WHITE ? shift(pawns, noWe) | shift(pawns, noEa) : shift(pawns, soWe) | shift(pawns, soEa);
+}
+inline U64 adjacentFiles(U64 BB) {
+    return ((BB << 1) & notAFile) | ((BB >> 1) & notHFile);
+}
+
+/* The pawn table caches the evaluation of the pawn structure.
+ * The pawns only change on pawn moves and captures of pawns, so nearly every probe hits, and the evaluation can be as rich as we like.
+ * It's indexed by the pawn zobrist hash, which only holds the pawns. Terms that depend on other pieces (e.g. the king's shield) can't go in here.
+ * */
+#define PAWN_TABLE_SIZE 16384 // the number of entries. must be a power of 2
+
+struct PawnEntry {
+    Zobrist key = 0; // the full pawn hash, to check for collisions
+    int16_t eval[2] = {0, 0}; // the middlegame and endgame pawn structure evaluation, relative to white
+};
+
+class PawnTable {
+    std::vector<PawnEntry> table;
+
+public:
+    /* These stats keep track of the hit rate */
+    int totalProbeCalls = 0, totalProbeFound = 0;
+
+    PawnTable(): table(PAWN_TABLE_SIZE) {}
+
+    inline PawnEntry* probe(Zobrist key, bool &found) {
+        // returns the entry for a pawn hash, and whether it holds this pawn structure
+        totalProbeCalls ++;
+
+        PawnEntry *entry = &table[key & (PAWN_TABLE_SIZE - 1)];
+        found = (entry->key == key);
+        totalProbeFound += found;
+
+        return entry;
+    }
+    void clear() {
+        std::fill(table.begin(), table.end(), PawnEntry());
+        totalProbeCalls = totalProbeFound = 0;
+    }
+};
+
+#endif //EVALUATION_PAWNS_CPP
@@ -0,0 +1,281 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NNUE_X86_KERNELS // we can compile kernels for newer CPUs than the build targets, and pick between them when we start
+#include <immintrin.h>
+#endif
+
+#ifndef EVALUATION_SIMD_CPP
+#define EVALUATION_SIMD_CPP
+
+/* NNUE kernels
+ * The network spends nearly all its time in a few loops, so each has a SIMD version for AVX-512 (with VNNI), AVX2 and SSE4.1.
+ * The best one the CPU supports is picked at runtime, so one build runs everywhere. Other compilers/ CPUs get the scalar versions.
+ * Every kernel gives exactly the same result as its scalar version, which checkNNUEKernels tests.
+    * addWeights/ subWeights: values += weights, for the accumulator updates. size must be a multiple of 32
+    * clipAccumulator: clamps int16 values to [0, 127] as uint8, for the first layer's output. size must be a multiple of 64
+    * clippedReLU: shifts int32 values down by shift, and clamps them to [0, 127] as uint8. size must be a multiple of 32
+    * affine: output = biases + weights * input, with uint8 inputs and int8 weights ([output][input]). inputSize must be a multiple of 32
+ * */
+struct NNUEKernelSet {
+    const char *name;
+    void (*addWeights)(int16_t *values, const int16_t *weights, int size);
+    void (*subWeights)(int16_t *values, const int16_t *weights, int size);
+    void (*clipAccumulator)(const int16_t *input, uint8_t *output, int size);
+    void (*clippedReLU)(const int32_t *input, uint8_t *output, int size, int shift);
+    void (*affine)(const uint8_t *input, int inputSize, const int8_t *weights, const int32_t *biases, int32_t *output, int outputSize);
+};
+
+/* Scalar kernels. these are the reference the others are checked against */
+void addWeightsScalar(int16_t *values, const int16_t *weights, int size) {
+    for (int i = 0; i < size; i ++) values[i] += weights[i];
+}
+void subWeightsScalar(int16_t *values, const int16_t *weights, int size) {
+    for (int i = 0; i < size; i ++) values[i] -= weights[i];
+}
+void clipAccumulatorScalar(const int16_t *input, uint8_t *output, int size) {
+    for (int i = 0; i < size; i ++) output[i] = std::clamp((int) input[i], 0, 127);
+}
+void clippedReLUScalar(const int32_t *input, uint8_t *output, int size, int shift) {
+    for (int i = 0; i < size; i ++) output[i] = std::clamp(input[i] >> shift, 0, 127);
+}
+void affineScalar(const uint8_t *input, int inputSize, const int8_t *weights, const int32_t *biases, int32_t *output, int outputSize) {
+    for (int o = 0; o < outputSize; o ++) {
+        int32_t sum = biases[o];
+        for (int i = 0; i < inputSize; i ++) sum += weights[o * inputSize + i] * input[i];
+        output[o] = sum;
+    }
+}
+const NNUEKernelSet scalarKernels = {"scalar", addWeightsScalar, subWeightsScalar, clipAccumulatorScalar, clippedReLUScalar, affineScalar};
+
+#ifdef NNUE_X86_KERNELS
+/* SSE4.1 kernels
+ * The affine layers use maddubs, which multiplies uint8 by int8 and adds neighbouring pairs into int16 with saturation.
+ * The inputs are at most 127, so a pair is at most 2 * 127 * 128, which fits. That's why the kernels match the scalar ones exactly.
+ * */
+__attribute__((target("sse4.1")))
+void addWeightsSSE41(int16_t *values, const int16_t *weights, int size) {
+    for (int i = 0; i < size; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (values + i)), w = _mm_loadu_si128((const __m128i *) (weights + i));
+        _mm_storeu_si128((__m128i *) (values + i), _mm_add_epi16(v, w));
+    }
+}
+__attribute__((target("sse4.1")))
+void subWeightsSSE41(int16_t *values, const int16_t *weights, int size) {
+    for (int i = 0; i < size; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (values + i)), w = _mm_loadu_si128((const __m128i *) (weights + i));
+        _mm_storeu_si128((__m128i *) (values + i), _mm_sub_epi16(v, w));
+    }
+}
+__attribute__((target("sse4.1")))
+void clipAccumulatorSSE41(const int16_t *input, uint8_t *output, int size) {
+    // packs saturates to [-128, 127], and the max takes off the negatives
+    for (int i = 0; i < size; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (input + i)), b = _mm_loadu_si128((const __m128i *) (input + i + 8));
+        _mm_storeu_si128((__m128i *) (output + i), _mm_max_epi8(_mm_packs_epi16(a, b), _mm_setzero_si128()));
+    }
+}
+__attribute__((target("sse4.1")))
+void clippedReLUSSE41(const int32_t *input, uint8_t *output, int size, int shift) {
+    for (int i = 0; i < size; i += 16) {
+        __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (input + i)), shift);
+        __m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (input + i + 4)), shift);
+        __m128i c = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (input + i + 8)), shift);
+        __m128i d = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (input + i + 12)), shift);
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i *) (output + i), _mm_max_epi8(packed, _mm_setzero_si128()));
+    }
+}
+__attribute__((target("sse4.1")))
+void affineSSE41(const uint8_t *input, int inputSize, const int8_t *weights, const int32_t *biases, int32_t *output, int outputSize) {
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int o = 0; o < outputSize; o ++) {
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < inputSize; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *) (input + i));
+            __m128i w = _mm_loadu_si128((const __m128i *) (weights + o * inputSize + i));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E)); // add the high half to the low half
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1)); // then the neighbouring pairs
+        output[o] = biases[o] + _mm_cvtsi128_si32(sum);
+    }
+}
+const NNUEKernelSet SSE41Kernels = {"sse4.1", addWeightsSSE41, subWeightsSSE41, clipAccumulatorSSE41, clippedReLUSSE41, affineSSE41};
+
+/* AVX2 kernels
+ * The 256 bit packs work on each 128 bit lane separately, so their results need permuting back into order.
+ * */
+__attribute__((target("avx2")))
+void addWeightsAVX2(int16_t *values, const int16_t *weights, int size) {
+    for (int i = 0; i < size; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (values + i)), w = _mm256_loadu_si256((const __m256i *) (weights + i));
+        _mm256_storeu_si256((__m256i *) (values + i), _mm256_add_epi16(v, w));
+    }
+}
+__attribute__((target("avx2")))
+void subWeightsAVX2(int16_t *values, const int16_t *weights, int size) {
+    for (int i = 0; i < size; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (values + i)), w = _mm256_loadu_si256((const __m256i *) (weights + i));
+        _mm256_storeu_si256((__m256i *) (values + i), _mm256_sub_epi16(v, w));
+    }
+}
+__attribute__((target("avx2")))
+void clipAccumulatorAVX2(const int16_t *input, uint8_t *output, int size) {
+    for (int i = 0; i < size; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (input + i)), b = _mm256_loadu_si256((const __m256i *) (input + i + 16));
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), _mm256_setzero_si256());
+        _mm256_storeu_si256((__m256i *) (output + i), _mm256_permute4x64_epi64(packed, 0xD8)); // lanes 0, 2, 1, 3
+    }
+}
+__attribute__((target("avx2")))
+void clippedReLUAVX2(const int32_t *input, uint8_t *output, int size, int shift) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    for (int i = 0; i < size; i += 32) {
+        __m256i a = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *) (input + i)), shift);
+        __m256i b = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *) (input + i + 8)), shift);
+        __m256i c = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *) (input + i + 16)), shift);
+        __m256i d = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *) (input + i + 24)), shift);
+        __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        packed = _mm256_max_epi8(packed, _mm256_setzero_si256());
+        _mm256_storeu_si256((__m256i *) (output + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+}
+__attribute__((target("avx2")))
+void affineAVX2(const uint8_t *input, int inputSize, const int8_t *weights, const int32_t *biases, int32_t *output, int outputSize) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int o = 0; o < outputSize; o ++) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < inputSize; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i *) (input + i));
+            __m256i w = _mm256_loadu_si256((const __m256i *) (weights + o * inputSize + i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+        output[o] = biases[o] + _mm_cvtsi128_si32(half);
+    }
+}
+const NNUEKernelSet AVX2Kernels = {"avx2", addWeightsAVX2, subWeightsAVX2, clipAccumulatorAVX2, clippedReLUAVX2, affineAVX2};
+
+/* AVX-512 kernels
+ * VNNI's dpbusd does the uint8 * int8 multiply and the sum into int32 in one go, without the int16 step.
+ * Layers that are too small for 512 bit vectors use the AVX2 kernels.
+ * */
+__attribute__((target("avx512f,avx512bw")))
+void addWeightsAVX512(int16_t *values, const int16_t *weights, int size) {
+    if (size % 32) return addWeightsAVX2(values, weights, size);
+    for (int i = 0; i < size; i += 32) {
+        __m512i v = _mm512_loadu_si512(values + i), w = _mm512_loadu_si512(weights + i);
+        _mm512_storeu_si512(values + i, _mm512_add_epi16(v, w));
+    }
+}
+__attribute__((target("avx512f,avx512bw")))
+void subWeightsAVX512(int16_t *values, const int16_t *weights, int size) {
+    if (size % 32) return subWeightsAVX2(values, weights, size);
+    for (int i = 0; i < size; i += 32) {
+        __m512i v = _mm512_loadu_si512(values + i), w = _mm512_loadu_si512(weights + i);
+        _mm512_storeu_si512(values + i, _mm512_sub_epi16(v, w));
+    }
+}
+__attribute__((target("avx512f,avx512bw")))
+void clipAccumulatorAVX512(const int16_t *input, uint8_t *output, int size) {
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    for (int i = 0; i < size; i += 64) {
+        __m512i a = _mm512_loadu_si512(input + i), b = _mm512_loadu_si512(input + i + 32);
+        __m512i packed = _mm512_max_epi8(_mm512_packs_epi16(a, b), _mm512_setzero_si512());
+        _mm512_storeu_si512(output + i, _mm512_permutexvar_epi64(order, packed));
+    }
+}
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+void affineAVX512VNNI(const uint8_t *input, int inputSize, const int8_t *weights, const int32_t *biases, int32_t *output, int outputSize) {
+    if (inputSize % 64) return affineAVX2(input, inputSize, weights, biases, output, outputSize);
+    for (int o = 0; o < outputSize; o ++) {
+        __m512i sum = _mm512_setzero_si512();
+        for (int i = 0; i < inputSize; i += 64) {
+            __m512i x = _mm512_loadu_si512(input + i), w = _mm512_loadu_si512(weights + o * inputSize + i);
+            sum = _mm512_dpbusd_epi32(sum, x, w);
+        }
+        output[o] = biases[o] + _mm512_reduce_add_epi32(sum);
+    }
+}
+const NNUEKernelSet AVX512VNNIKernels = {"avx512 vnni", addWeightsAVX512, subWeightsAVX512, clipAccumulatorAVX512, clippedReLUAVX2, affineAVX512VNNI};
+#endif
+
+NNUEKernelSet NNUEKernels = scalarKernels; // the kernels the network uses
+
+std::vector<NNUEKernelSet> supportedNNUEKernels() {
+    // every kernel set the CPU supports, worst first
+    std::vector<NNUEKernelSet> kernels = {scalarKernels};
+#ifdef NNUE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) kernels.push_back(SSE41Kernels);
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(AVX2Kernels);
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) {
+        kernels.push_back(AVX512VNNIKernels);
+    }
+#endif
+    return kernels;
+}
+void selectNNUEKernels() {
+    // picks the best kernels the CPU supports
+    NNUEKernels = supportedNNUEKernels().back();
+}
+bool checkNNUEKernels(const NNUEKernelSet &kernels) {
+    /* Runs the kernels on random data, and checks they match the scalar ones exactly.
+     * The values cover the edge cases: accumulators past both ends of the clip, and the largest inputs and weights.
+     * */
+    const int size = 512, outputs = 32;
+    uint64_t seed = 0x2545F4914F6CDD1D;
+    auto random = [&seed]() {
+        seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+        return (uint32_t) ((seed * 2685821657736338717ULL) >> 32);
+    };
+
+    alignas(64) int16_t values[size], expectedValues[size], weights[size];
+    alignas(64) int32_t wide[size], biases[outputs], output[outputs], expectedOutput[outputs];
+    alignas(64) uint8_t clipped[size], expectedClipped[size];
+    alignas(64) int8_t affineWeights[outputs * size];
+
+    for (int i = 0; i < size; i ++) {
+        values[i] = expectedValues[i] = (int16_t) (random() % 1024) - 512;
+        weights[i] = (int16_t) (random() % 512) - 256;
+        wide[i] = (int32_t) (random() % 32768) - 8192;
+    }
+    for (int i = 0; i < outputs * size; i ++) affineWeights[i] = (int8_t) (random() & 255);
+    for (int i = 0; i < outputs; i ++) biases[i] = (int32_t) (random() % 4096) - 2048;
+
+    bool ok = true;
+    kernels.addWeights(values, weights, size);
+    addWeightsScalar(expectedValues, weights, size);
+    kernels.subWeights(values, weights + 32, size - 32);
+    subWeightsScalar(expectedValues, weights + 32, size - 32);
+    ok &= !memcmp(values, expectedValues, sizeof(values));
+
+    kernels.clipAccumulator(values, clipped, size);
+    clipAccumulatorScalar(expectedValues, expectedClipped, size);
+    ok &= !memcmp(clipped, expectedClipped, size);
+
+    kernels.clippedReLU(wide, clipped, 64, 6);
+    clippedReLUScalar(wide, expectedClipped, 64, 6);
+    ok &= !memcmp(clipped, expectedClipped, 64);
+
+    for (int i = 0; i < size; i ++) clipped[i] = (i % 7) ? random() % 128 : 127; // inputs are at most 127 after a clip
+    for (int inputSize: {size, 32}) {
+        kernels.affine(clipped, inputSize, affineWeights, biases, output, outputs);
+        affineScalar(clipped, inputSize, affineWeights, biases, expectedOutput, outputs);
+        ok &= !memcmp(output, expectedOutput, sizeof(output));
+    }
+
+    return ok;
+}
+
+#endif //EVALUATION_SIMD_CPP
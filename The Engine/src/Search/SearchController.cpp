@@ -9,11 +9,13 @@
 #include "Transposition Table/zobrist.h"
 #include "search.cpp"
 #include "SearchController.h"
+#include "Tablebases/tbprobe.cpp"
 
 /* Constructor */
-SearchController::SearchController(SearchParameters &searchParamsIn): nativeTT(searchParamsIn) {
-    /* init the TT */
+SearchController::SearchController(SearchParameters &searchParamsIn): nativeTT(searchParamsIn), nativeEvalCache(searchParamsIn.evalCacheSizeMb) {
+    /* init the TT and eval cache */
     joinTT(&nativeTT);
+    joinEvalCache(&nativeEvalCache);
 
     searchParameters = &searchParamsIn;
 
@@ -25,9 +27,7 @@ SearchController::SearchController(SearchParameters &searchParamsIn): nativeTT(s
     /* this should be looked into/optimised */
     activeMoveList.reserve(100);
     quietMoveList.reserve(100);
-    moveHistory.reserve(100);
     combinedMoveList.reserve(200);
-    enPassantHistory.reserve(100);
 }
 
 /* Make Move */
@@ -36,8 +36,10 @@ void SearchController::makeMove(Move move) {
     //TODO Zobrist needs to changed based on enpassant right and castle rights. And in SetSquare. And in SwitchPlayer. ANd updated enpassant rights in inner move on fdouble pawn push.
 
     /* Update the zobrist hash. We do this first so the side doesn't switch */
-    prevZobristStates.emplace_back(zobristState);
-    prevMaterialEvaluations.emplace_back(materialEvaluation);
+    stack[moveNumber].key = zobristState;
+    stack[moveNumber].pawnKey = pawnZobristState;
+    stack[moveNumber].materialKey = materialZobristState;
+    saveEvaluation(stack[moveNumber]);
     updateAfterMove(move);
     updateEnPassZobrist();
     updateCastlingZobrist();
@@ -45,6 +47,7 @@ void SearchController::makeMove(Move move) {
 
     /* ACTUALLY MAKE THE MOVE */
     innerMakeMove(move);
+    invalidateAccumulator();
 
     /* These functions are called twice to xor our the existing rights, and xor in the new ones */
     updateEnPassZobrist();
@@ -54,13 +57,58 @@ void SearchController::unMakeMove() {
     /* ACTUALLY UNMAKE THE MOVE */
     innerUnMakeMove();
 
-    /* Reload the previous Zobrist hash */
-    zobristState = prevZobristStates.back();
-    prevZobristStates.pop_back();
+    /* Reload the previous Zobrist hash and material evaluation */
+    zobristState = stack[moveNumber].key;
+    pawnZobristState = stack[moveNumber].pawnKey;
+    materialZobristState = stack[moveNumber].materialKey;
+    loadEvaluation(stack[moveNumber]);
+}
+void SearchController::makeNullMove() {
+    /* Pass the turn to the other side without moving. This is used for null move pruning.
+     * Like after a real move, any en-passant rights are lost.
+     * */
+    StackEntry &entry = stack[moveNumber];
+    entry.key = zobristState;
+    entry.pawnKey = pawnZobristState;
+    entry.materialKey = materialZobristState;
+    entry.numChanges = 0; // so the accumulators are just copied
+    saveEvaluation(entry);
+    entry.move = 0; // so the next move doesn't think it's replying to our last real move
+    entry.castleRights = CastleRights;
+    entry.enPassantRights = enPassantRights;
+    entry.halfMoveClock = halfMoveClock;
+
+    updateEnPassZobrist(); // xor out the en-passant rights
+    clearEnPassRights();
+    halfMoveClock = 0; // positions before a null move can't be repeated after it
 
-    /* reload previous material evaluation */
-    materialEvaluation = prevMaterialEvaluations.back();
-    prevMaterialEvaluations.pop_back();
+    updateSideZobrist();
+    innerSwitchSide();
+    assert(moveNumber < MAX_GAME_LENGTH - 1); // the stack is full
+    moveNumber ++;
+    invalidateAccumulator();
+}
+void SearchController::unMakeNullMove() {
+    moveNumber --;
+    innerSwitchSide();
+    undoEnPassRights();
+    halfMoveClock = stack[moveNumber].halfMoveClock;
+
+    /* Reload the previous Zobrist hash and material evaluation */
+    zobristState = stack[moveNumber].key;
+    pawnZobristState = stack[moveNumber].pawnKey;
+    materialZobristState = stack[moveNumber].materialKey;
+    loadEvaluation(stack[moveNumber]);
+}
+void SearchController::saveEvaluation(StackEntry &entry) {
+    entry.material[MG] = materialEvaluation[MG];
+    entry.material[EG] = materialEvaluation[EG];
+    entry.phase = gamePhase;
+}
+void SearchController::loadEvaluation(StackEntry &entry) {
+    materialEvaluation[MG] = entry.material[MG];
+    materialEvaluation[EG] = entry.material[EG];
+    gamePhase = entry.phase;
 }
 MoveList SearchController::getMoveList() {
     // returns the regular move list
@@ -72,21 +120,18 @@ MoveList SearchController::getMoveList() {
 void SearchController::readFEN(string FEN) {
     readFENInner(FEN);
 
-    /* Clear the TT table, if initialised */
-    TT->clear();
+    /* Note the TT is not cleared here. This is called before every move in UCI mode, and the entries from
+     * the previous search are still useful. It is cleared on ucinewgame instead. */
 
-    /* clear the search's history */
-    prevZobristStates.clear();
-    moveHistory.clear();
-    enPassantHistory.clear();
-    CastleRightsHistory.clear();
-    moveNumber = 1;
+    /* the history is cleared by readFENInner, which resets the move number (and so the stack) */
 
     /* Recalculate the Zobrist hash */
     calculateAndSetZobristHash();
 
-    /* Recalculate the material balance */
-    materialEvaluation = biasedMaterial();
+    /* Recalculate the material balance and game phase */
+    calculateEvaluation();
+    saveEvaluation(stack[moveNumber]);
+    invalidateAccumulator();
 }
 void SearchController::switchSide() {
     innerSwitchSide();
@@ -97,7 +142,8 @@ bool SearchController::validateZobrist() {
     // this is used to see whether the incrementally calculated zobrist hash is equal to the one calculated from scratch
 
     Zobrist created = calculateZobristHash();
-    return zobristState == created;
+    return (zobristState == created) && (pawnZobristState == calculatePawnZobristHash()) &&
+           (materialZobristState == calculateMaterialZobristHash());
 }
 Zobrist SearchController::calculateZobristHash() {
     // recalculates the zobrist hash from scratch
@@ -131,19 +177,99 @@ Zobrist SearchController::calculateZobristHash() {
 
     return key;
 }
+Zobrist SearchController::getPolyglotKey() {
+    /* Calculates the key of this position used by Polyglot opening books. It isn't kept incrementally, as it's only needed at the root.
+     * How does it work?
+     * 1. Xor in the pieces. Our squares are flipped, so the row is counted back from rank 1.
+     * 2. Xor in the castle rights. Our bits go white queen side, white king side, black queen side, black king side.
+     * 3. Xor in the en-passant file, but only if one of our pawns is next to the pawn that just double pushed.
+     * 4. Xor in the turn if it's white to move.
+     * */
+    Zobrist key = 0;
+
+    // * 1.
+    for (short pc = PAWN; pc <= KING; pc ++) {
+        for (Side side: {WHITE, BLACK}) {
+            short kind = pc * 2 + (side == WHITE);
+            for (short sq: toArray(getPieces(pc, side))) {
+                short row = 7 - sq / 8, file = sq % 8;
+                key ^= polyglotRandom64[POLYGLOT_PIECE + 64 * kind + 8 * row + file];
+            }
+        }
+    }
+
+    // * 2.
+    const short castleOrder[4] = {2, 1, 8, 4};
+    for (int i = 0; i < 4; i ++) {
+        if (CastleRights & castleOrder[i]) key ^= polyglotRandom64[POLYGLOT_CASTLE + i];
+    }
+
+    // * 3.
+    if (enPassantRights) {
+        EnPassantRights rights = enPassantRights;
+        short file = pop8BitIntLSB(rights);
+        short pushedPawn = (currentSide == WHITE) ? A5 + file : A4 + file;
+        U64 neighbours = 0;
+        if (file > 0) neighbours |= toBB(pushedPawn - 1);
+        if (file < 7) neighbours |= toBB(pushedPawn + 1);
+        if (neighbours & getPieces(PAWN, currentSide)) key ^= polyglotRandom64[POLYGLOT_EN_PASSANT + file];
+    }
+
+    // * 4.
+    if (currentSide == WHITE) key ^= polyglotRandom64[POLYGLOT_TURN];
+
+    return key;
+}
+Zobrist SearchController::getStartPolyglotKey() {
+    // the polyglot key of the start position, from the random table alone. it's used to check the table, without setting up a board
+    const short backRank[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+    Zobrist key = 0;
+    for (short file = 0; file < 8; file ++) {
+        for (Side side: {WHITE, BLACK}) {
+            short backRow = (side == WHITE) ? 0 : 7, pawnRow = (side == WHITE) ? 1 : 6;
+            key ^= polyglotRandom64[POLYGLOT_PIECE + 64 * (backRank[file] * 2 + (side == WHITE)) + 8 * backRow + file];
+            key ^= polyglotRandom64[POLYGLOT_PIECE + 64 * (PAWN * 2 + (side == WHITE)) + 8 * pawnRow + file];
+        }
+    }
+    for (int i = 0; i < 4; i ++) key ^= polyglotRandom64[POLYGLOT_CASTLE + i];
+    key ^= polyglotRandom64[POLYGLOT_TURN];
+
+    return key;
+}
 void SearchController::calculateAndSetZobristHash() {
     // recalculates the zobrist hash from scratch, and sets it as the current hash
     zobristState = calculateZobristHash();
-    prevZobristStates.emplace_back(zobristState);
+    stack[moveNumber].key = zobristState;
+    pawnZobristState = calculatePawnZobristHash();
+    stack[moveNumber].pawnKey = pawnZobristState;
+    materialZobristState = calculateMaterialZobristHash();
+    stack[moveNumber].materialKey = materialZobristState;
+}
+Zobrist SearchController::calculatePawnZobristHash() {
+    // recalculates the pawn hash from scratch. it only holds the pawns, so it can index the pawn table
+    Zobrist key = 0;
+    for (Side side: {WHITE, BLACK}) {
+        for (short sq: toArray(getPieces(PAWN, side))) key ^= pieceKeys[PAWN + 6 * side][sq];
+    }
+    return key;
+}
+Zobrist SearchController::calculateMaterialZobristHash() {
+    // recalculates the material hash from scratch. the kings are included, so no position has a hash of 0 (the key of an empty table entry)
+    Zobrist key = 0;
+    for (Side side: {WHITE, BLACK}) {
+        for (short pc = PAWN; pc <= KING; pc ++) {
+            for (short n = 0; n < count(getPieces(pc, side)); n ++) key ^= materialKeys[pc + 6 * side][n];
+        }
+    }
+    return key;
 }
 void SearchController::updateAfterMove(Move move) {
-    /* Updates the zobrist hash after a move has been made. We also update material evaluation
+    /* Updates the zobrist hash after a move has been made. We also update the material evaluation and game phase
      * Switching the side is done separately, as we may want to switch sides without making a move
      * */
     short from, to, promo, flag, fromType, toType;
     decodeMove(move, from, to, promo, flag, fromType, toType);
-
-    int PSTIncriment = 0; // the change to the PST values. this needs to be multiplied by 1/ -1 depending on the currentSide
+    stack[moveNumber].numChanges = 0;
 
     if (flag == ENPASSANT) {
         short enPassSquare; // the square of the pawn we are taking
@@ -153,19 +279,18 @@ void SearchController::updateAfterMove(Move move) {
             enPassSquare = to - 8;
         }
 
-        // update material balance
-        materialEvaluation += PieceWorths[PAWN + currentSide * 6];
-        PSTIncriment += PST[PAWN][currentSide][to];
-        PSTIncriment -= PST[PAWN][currentSide][from];
-        PSTIncriment -= PST[PAWN][otherSide][enPassSquare] * -1;
-
-
         // xor in and out our pawn
         zobristXOR(PAWN, from, currentSide);
         zobristXOR(PAWN, to, currentSide);
 
         // xor out the taken pawn
         zobristXOR(PAWN, enPassSquare, otherSide); // xor out the taken pawn
+        materialXOR(PAWN, count(getPieces(PAWN, otherSide)) - 1, otherSide);
+
+        // update material balance
+        updatePieceEvaluation(PAWN, from, currentSide, -1);
+        updatePieceEvaluation(PAWN, to, currentSide, 1);
+        updatePieceEvaluation(PAWN, enPassSquare, otherSide, -1);
     } else if (flag == CASTLING) {
         // xor out the castle and king from their old positions
         zobristXOR(KING, from, currentSide); // xor out the king
@@ -179,37 +304,32 @@ void SearchController::updateAfterMove(Move move) {
         zobristXOR(ROOK, newRook, currentSide); // xor out the rook
 
         // update material balance
-        PSTIncriment += PST[ROOK][currentSide][newRook];
-        PSTIncriment += PST[KING][currentSide][newKing];
-        PSTIncriment -= PST[KING][currentSide][from];
-        PSTIncriment -= PST[ROOK][currentSide][to];
+        updatePieceEvaluation(KING, from, currentSide, -1);
+        updatePieceEvaluation(ROOK, to, currentSide, -1);
+        updatePieceEvaluation(KING, newKing, currentSide, 1);
+        updatePieceEvaluation(ROOK, newRook, currentSide, 1);
     } else {
         zobristXOR(fromType, from, currentSide); // xor out the start square, start player
-
-        PSTIncriment -= PST[fromType][currentSide][from];  // update material balance
+        updatePieceEvaluation(fromType, from, currentSide, -1); // update material balance
 
         // xor out the end square, if occupied
         if (toType != EMPTY) {
-            materialEvaluation += PieceWorths[toType + currentSide * 6]; // update material balance
-            PSTIncriment -= PST[toType][otherSide][to] * -1;
-
             zobristXOR(toType, to, otherSide); // xor out the end square, end player
+            materialXOR(toType, count(getPieces(toType, otherSide)) - 1, otherSide);
+            updatePieceEvaluation(toType, to, otherSide, -1); // update material balance
         }
 
         if (flag == PROMOTION) {
+            // the board hasn't changed yet, so these are the counts before the move
+            materialXOR(PAWN, count(getPieces(PAWN, currentSide)) - 1, currentSide);
             fromType = getPromoPiece(promo);
-
-            materialEvaluation -= PieceWorths[PAWN + currentSide * 6]; // update material balance
-            materialEvaluation += PieceWorths[fromType + currentSide * 6];
+            materialXOR(fromType, count(getPieces(fromType, currentSide)), currentSide);
         }
 
-        PSTIncriment += PST[fromType][currentSide][to];
-
         // xor out the end square, start player.
         zobristXOR(fromType, to, currentSide);
+        updatePieceEvaluation(fromType, to, currentSide, 1); // update material balance
     }
-
-    materialEvaluation += PSTIncriment * (currentSide == WHITE ? 1 : -1); // add the PST increment to the material balance
 }
 void SearchController::updateEnPassZobrist() {
     // xor out en-pass rights
@@ -229,6 +349,21 @@ void SearchController::updateCastlingZobrist() {
 inline void SearchController::zobristXOR(short piece, short square, Side side) {
     // XOR's a piece at a certain square
     zobristState ^= pieceKeys[piece + 6 * side][square];
+    if (piece == PAWN) pawnZobristState ^= pieceKeys[piece + 6 * side][square];
+}
+inline void SearchController::materialXOR(short piece, short count, Side side) {
+    // XOR's the key for the count-th piece of a type (counting from 0). it's xor-ed in when the piece arrives, and out when it leaves
+    materialZobristState ^= materialKeys[piece + 6 * side][count];
+}
+inline void SearchController::updatePieceEvaluation(short piece, short square, Side side, int sign) {
+    // adds (sign = 1) or removes (sign = -1) a piece at a certain square from the evaluation and game phase
+    StackEntry &entry = stack[moveNumber];
+    entry.changes[entry.numChanges ++] = {piece, side, square, (short) sign}; // the NNUE accumulators are updated from these when they're needed
+
+    int whiteSign = (side == WHITE) ? sign : -sign; // the evaluation is relative to white
+    materialEvaluation[MG] += whiteSign * (PieceValues[MG][piece] + PST[MG][piece][side][square]);
+    materialEvaluation[EG] += whiteSign * (PieceValues[EG][piece] + PST[EG][piece][side][square]);
+    gamePhase += sign * PhaseWeights[piece];
 }
 void SearchController::updateSideZobrist() {
     /* Updates the zobrist hash after switching sides */
@@ -250,17 +385,25 @@ bool SearchController::inCheckMate() {
 inline bool SearchController::checkThreefold() {
     /* check for checkThreefold repetition */
 
-    // loop through every other zobrist state from the current one
-    // the current state is only added to the prevStates vector once a move is made
-    if (moveNumber < 7) return false;
-
+    // a position can only repeat since the last capture or pawn move, so we only look back that far
+    // the same side must be to move, and it takes at least 4 plies to get back to the same position
+    int oldest = std::max(moveNumber - halfMoveClock, 1);
     int reps = 1;
-    // loop backwards through the previous states. moveNumber starts at 1, hence we start at moveNumber - 2
-    for (int i = moveNumber - 2; i >= 0; i -= 2) {
-        if (zobristState == prevZobristStates[i]) reps ++;
+    for (int i = moveNumber - 4; i >= oldest; i -= 2) {
+        if (zobristState == stack[i].key) {
+            // a repetition inside the search tree is a draw, as either side could repeat it again
+            if (i >= rootMoveNumber) return true;
+
+            reps ++;
+            if (reps >= 3) return true;
+        }
     }
 
-    return reps >= 3;
+    return false;
+}
+inline bool SearchController::isDraw() {
+    // draws by repetition or the fifty move rule. check-mate needs to be checked first, as it takes priority over the fifty move rule
+    return (halfMoveClock >= 100) || checkThreefold();
 }
 bool SearchController::inStalemate() {
     // you are in inStalemate if there are no moves and you're not in check
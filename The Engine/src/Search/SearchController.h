@@ -5,6 +5,12 @@
 #include "../Board/board.cpp"
 #include "Transposition Table/zobrist.h"
 #include "Transposition Table/TT.cpp"
+#include "TimeManager.cpp"
+#include "Tablebases/syzygy.cpp"
+#include "Evaluation/pawns.cpp"
+#include "Evaluation/material.cpp"
+#include "Evaluation/nnue.cpp"
+#include "Evaluation/evalcache.cpp"
 
 #ifndef SEARCH_CPP_SEARCHCONTROLLER_H
 #define SEARCH_CPP_SEARCHCONTROLLER_H
@@ -18,12 +24,17 @@ class SearchController: public Board {
 private:
     // TODO NON CORE - WILL BE STRIPPED
     /* evaluation variables */
-    int materialEvaluation = 0; // holds the value of the material on the board,
+    int materialEvaluation[2] = {0, 0}; // the material and PST values on the board, for the middlegame and endgame. relative to white
+    int gamePhase = 0; // how much non-pawn material is on the board. TOTAL_PHASE at the start, 0 with just pawns
+    inline void updatePieceEvaluation(short piece, short square, Side side, int sign);
+    void saveEvaluation(StackEntry &entry);
+    void loadEvaluation(StackEntry &entry);
 
     /* Zobrist */
-    Zobrist zobristState; // current zobrist hash
-    vector<Zobrist> prevZobristStates; // stores previous zobrist hashes
-    vector<int> prevMaterialEvaluations; // stores previous material evaluations
+    Zobrist zobristState; // current zobrist hash. past hashes (and material evaluations) are kept on the stack
+    Zobrist pawnZobristState; // the zobrist hash of just the pawns, used to index the pawn table
+    Zobrist materialZobristState; // the zobrist hash of the piece counts, used to index the material table
+    inline void materialXOR(short piece, short count, Side side);
     void updateAfterMove(Move move);
     void updateSideZobrist();
     inline void zobristXOR(short piece, short square, Side side);
@@ -35,25 +46,72 @@ private:
     SearchStats searchStats; // we store internal stats and flush them on to global stats when required
     SearchStats *globalStats; // store a reference to the global SearchStats
 
+    /* Stopping the search */
+    SearchSignals *searchSignals = &noSignals; // signals from outside the search e.g. to stop it
+    bool searchAborted = false; // set once we've been told to stop. everything searched after this is garbage
+    bool wasPondering = false; // whether we were pondering the last time we checked. used to spot a ponderhit
+    SearchInfoCallback infoCallback = nullptr; // called after every iteration e.g. to send UCI info
+
+    /* Principal variation
+     * A triangular table: row ply holds the best line found from ply. When a move raises alpha, it's followed by the row below it.
+     * */
+    Move PVTable[MAX_PLY + 1][MAX_PLY + 1] = {};
+    int PVLength[MAX_PLY + 1] = {};
+
+    /* Move ordering */
+    MoveList rootMoves; // if it isn't empty, the root only searches these moves (e.g. the ones the tablebases say keep the best result)
+    int rootMoveNumber = 1; // the move number at the root of the search, used to work out the ply
+    int historyTable[2][64][64] = {}; // [side][from][to] scores for quiet moves that cause cut-offs
+    Move counterMoves[2][64][64] = {}; // [side][from][to] of the previous move -> the quiet move that refuted it
+
+    /* Search limits */
+    SearchLimits searchLimits; // the limits for the current search
+    TimeManager timeManager;
+
     /* Transposition table */
     TranspositionTable *TT; // the TT is accessed through a pointer, so we can link to an external one as required
     TranspositionTable nativeTT; // we store a native TT
 
+    /* Pawn table */
+    PawnTable pawnTable; // caches the pawn structure evaluation. each board has its own, as it's cheap to refill
+    MaterialTable materialTable; // caches everything that only depends on the piece counts
+
+    /* Eval cache */
+    EvalCache *evalCache; // like the TT, it's accessed through a pointer so it can be shared
+    EvalCache nativeEvalCache;
+
+    /* NNUE. there is an accumulator for every position on the stack, indexed by the move number.
+     * They're only allocated the first time the network is used, as they take a couple of megabytes for every board. */
+    std::vector<NNUEAccumulator> accumulators;
+    int accumulatorGeneration = 0; // the network generation the accumulators were computed with
+    void invalidateAccumulator() {if (!accumulators.empty()) accumulators[moveNumber].computed[WHITE] = accumulators[moveNumber].computed[BLACK] = false;}
+    void refreshAccumulator(short perspective);
+    void updateAccumulator(short perspective);
+
 public:
     // TODO CORE STUFF - THIS IS SAFE FROM BEING STRIPPED BACK
 
     /* Evaluation */
-    int SEE(short square);
-    int SEEMove(Move m);
-    int biasedMaterial();
+    int SEE(Move move);
+    bool SEEGreaterOrEqual(Move move, int threshold);
+    void calculateEvaluation();
+    int taperedEvaluation();
+    MaterialEntry* probeMaterial();
+    int evaluateNNUE();
+    void evaluatePawns(int *eval);
+    void evaluatePawnStructure(int *eval);
+    void evaluatePawnShield(int *eval);
     int evaluate();
     int relativeLazy();
+    int staticEvaluation();
 
     /* Constructor */
     SearchController(SearchParameters &searchParamsIn);
 
     void makeMove(Move move);
     void unMakeMove();
+    void makeNullMove();
+    void unMakeNullMove();
     MoveList getMoveList();
     MoveList getQMoveList();
     void readFEN(string FEN);
@@ -64,18 +122,31 @@ public:
     bool getInCheck();
     bool inCheckMate();
     inline bool checkThreefold();
+    inline bool isDraw();
     bool inStalemate();
     bool givesCheck(Move &move);
     short getCurrentSide();
     short getOtherSide();
-    int getMaterialEvaluation() {return materialEvaluation;}
-    MoveList getMoveHistory() {return moveHistory;}
+    int getMaterialEvaluation() {return taperedEvaluation();}
+    MoveList getMoveHistory() {
+        MoveList moveHistory;
+        for (int i = 1; i < moveNumber; i ++) moveHistory.emplace_back(stack[i].move);
+        return moveHistory;
+    }
 
     /* Linking to Global data stores */
     void joinTT(TranspositionTable *TTIn) {TT = TTIn;}
+    void joinNativeTT() {TT = &nativeTT;}
+    void joinEvalCache(EvalCache *evalCacheIn) {evalCache = evalCacheIn;}
+    void joinNativeEvalCache() {evalCache = &nativeEvalCache;}
     void joinSearchStats(SearchStats &stats) {globalStats = &stats;}
     void joinSearchParams(SearchParameters &params) {searchParameters = &params;}
+    void joinSearchSignals(SearchSignals &signals) {searchSignals = &signals;}
+    SearchSignals* getSearchSignals() {return searchSignals;}
+    void joinInfoCallback(SearchInfoCallback callback) {infoCallback = callback;}
+    SearchInfoCallback getInfoCallback() {return infoCallback;}
     TranspositionTable* getTT() {return TT;}
+    EvalCache* getEvalCache() {return evalCache;}
     SearchParameters* getSearchParameters() {return searchParameters;}
     SearchStats getStats() {return searchStats;}
     void clearStats() {
@@ -91,16 +162,42 @@ public:
     Zobrist getZobristState();
     Zobrist calculateZobristHash();
     void calculateAndSetZobristHash();
+    Zobrist calculatePawnZobristHash();
+    Zobrist calculateMaterialZobristHash();
+    Zobrist getPolyglotKey();
+    static Zobrist getStartPolyglotKey();
     void updateEnPassZobrist();
     void updateCastlingZobrist();
 
     void printBoardPrettily();
 
     /* Search Stuff */
-    void extractPV(MoveList &moves);
+    inline bool checkStop();
+    inline bool isCapture(Move move);
+    int getPly() {return std::min(moveNumber - rootMoveNumber, MAX_PLY - 1);}
+    void newSearch();
+    void scoreMoves(MoveList &moves, int *scores, Move TTMove, Move previousMove);
+    void scoreQuiescenceMoves(MoveList &moves, int *scores, Move TTMove);
+    inline void pickMove(MoveList &moves, int *scores, size_t index);
+    inline void updateHistory(Move move, int bonus);
+    void updateQuietHistory(Move move, Move *quietsSearched, int numQuietsSearched, int depth, Move previousMove);
+    void checkPonderhit();
+    void setSearchLimits(SearchLimits &limits);
+    TimeManager* getTimeManager() {return &timeManager;}
+    bool wasAborted() {return searchAborted;}
+    inline void updatePV(int ply, Move move);
+    void getPV(MoveList &PV);
     int quiescence(int alpha, int beta, int depth);
-    int negaMax(int alpha, int beta, int depth, Move &bestMove);
+    int negaMax(int alpha, int beta, int depth, Move &bestMove, bool allowNullMove = true);
     int firstPly(MoveList moves, int depth, Move &bestMove);
+    void setRootMoves(MoveList &moves) {rootMoves = moves;}
+
+    /* Tablebases */
+    TBPosition getTBPosition();
+    int probeWDLSearch(bool checkZeroingMoves, TBProbeState &result);
+    int probeWDL(TBProbeState &result);
+    int probeDTZ(TBProbeState &result);
+    bool probeRoot(MoveList &moves);
 };
 
 #endif //SEARCH_CPP_SEARCHCONTROLLER_H
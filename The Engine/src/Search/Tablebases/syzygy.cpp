@@ -0,0 +1,878 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <sys/stat.h>
+#include "../../types.h"
+
+#ifdef _WIN32
+#define NOMINMAX // windows.h would otherwise define min and max macros
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifndef SEARCH_SYZYGY_CPP
+#define SEARCH_SYZYGY_CPP
+
+/* Syzygy tablebases
+ * Every position with a few pieces left has been solved, and stored in two sets of files:
+    * .rtbw files (WDL) say whether the side to move wins, draws or loses. A cursed win is a win that the fifty move rule turns into a draw,
+      and a blessed loss is the same from the other side.
+    * .rtbz files (DTZ) give the number of plies to the next zeroing move (capture or pawn move) on the way to the result.
+ * The files are memory-mapped the first time they're probed, so only the pages we touch are read.
+ * This file reads the tables. Probing through the board (which needs to make moves) is in tbprobe.cpp.
+ *
+ * How is a position looked up?
+ * 1. Find the table for the material. If black has the stronger pieces, the colours are swapped and the board is flipped.
+ * 2. The position is mirrored, so the leading piece (or pawn) is in a small corner of the board.
+ * 3. The pieces are turned into an index: the leading group through special tables, then each group of identical pieces as a combination.
+ * 4. The values are compressed with recursive pairing and a canonical Huffman code. The index gives the block, and we decode the symbol in it.
+ *
+ * Squares here go from a1 = 0 to h8 = 63, as in the files. Ours are flipped, so the bitboards are byte swapped on the way in.
+ * */
+
+#define TB_PIECES 7 // the most pieces in any table
+
+enum WDLScore {
+    WDLLoss = -2, // loss
+    WDLBlessedLoss = -1, // loss, but draw under the fifty move rule
+    WDLDraw = 0,
+    WDLCursedWin = 1, // win, but draw under the fifty move rule
+    WDLWin = 2
+};
+enum TBProbeState {
+    TB_FAIL = 0, // the probe failed (e.g. the file is missing)
+    TB_OK = 1,
+    TB_CHANGE_STM = -1, // the DTZ table is for the other side to move
+    TB_ZEROING_BEST_MOVE = 2 // the best move is a zeroing move
+};
+enum TBType {WDL, DTZ};
+
+// flags stored with each table
+enum TBFlag {
+    TBFlagSTM = 1,
+    TBFlagMapped = 2,
+    TBFlagWinPlies = 4,
+    TBFlagLossPlies = 8,
+    TBFlagWide = 16,
+    TBFlagSingleValue = 128
+};
+
+/* The position in the form the tables want it */
+struct TBPosition {
+    U64 pieces[2][6] = {}; // [side][piece type], with a1 as bit 0
+    Side side = WHITE; // the side to move
+};
+
+/* Decompression data for one side (and one file of the leading pawn) of a table */
+typedef uint16_t Sym;
+struct LR {
+    // the two child symbols of a symbol, packed into 12 bits each
+    uint8_t lr[3];
+    Sym left() {return ((lr[1] & 0xF) << 8) | lr[0];}
+    Sym right() {return (lr[2] << 4) | (lr[1] >> 4);}
+};
+struct SparseEntry {
+    char block[4]; // the block that holds the value at the middle of the span
+    char offset[2]; // and its offset in the block
+};
+static_assert(sizeof(LR) == 3, "LR tree entry must be 3 bytes");
+static_assert(sizeof(SparseEntry) == 6, "SparseEntry must be 6 bytes");
+
+struct PairsData {
+    uint8_t flags = 0;
+    size_t sizeofBlock = 0; // in bytes
+    size_t span = 0; // the number of values between two sparse index entries
+    int numBlocks = 0;
+    int maxSymLen = 0, minSymLen = 0; // the longest/ shortest Huffman code, in bits
+    Sym *lowestSym = nullptr; // the lowest symbol of each code length
+    LR *btree = nullptr; // the pair each symbol expands to
+    uint16_t *blockLength = nullptr; // the number of values in each block (minus one)
+    int blockLengthSize = 0;
+    SparseEntry *sparseIndex = nullptr;
+    size_t sparseIndexSize = 0;
+    uint8_t *data = nullptr; // the compressed blocks
+    std::vector<uint64_t> base64; // the lowest code of each length, left aligned in 64 bits
+    std::vector<uint8_t> symlen; // the number of values each symbol expands to (minus one)
+    uint8_t pieces[TB_PIECES] = {}; // the order the pieces are encoded in
+    uint64_t groupIdx[TB_PIECES + 1] = {}; // the multiplier of each group in the index
+    int groupLen[TB_PIECES + 1] = {}; // the number of pieces in each group (zero terminated)
+    uint16_t mapIdx[4] = {}; // DTZ only: where each WDL result's value map starts
+};
+
+/* A table (one file). WDL tables store both sides to move, DTZ only one */
+struct TBTable {
+    TBType type;
+    std::string code; // e.g. KRvK
+    std::atomic<bool> ready = false; // whether we've tried to map the file
+    void *baseAddress = nullptr;
+    size_t mapping = 0; // the size of the mapping
+#ifdef _WIN32
+    HANDLE mappingHandle = nullptr; // windows keeps a handle to the mapping as well as the view of it
+#endif
+    uint8_t *map = nullptr; // DTZ only: the value maps
+    U64 key = 0, key2 = 0; // the material key with the code's first side as white, and as black
+    int pieceCount = 0;
+    bool hasPawns = false;
+    bool hasUniquePieces = false; // whether either side has a piece (other than the king) with no twin
+    uint8_t pawnCount[2] = {}; // [leading colour/ other colour]
+    PairsData items[2][4]; // [side to move][file of the leading pawn]
+
+    int sides() {return (type == WDL) ? 2 : 1;}
+    PairsData* get(int stm, int file) {return &items[stm % sides()][hasPawns ? file : 0];}
+};
+
+/* Global tablebase state */
+int TBLargest = 0; // the most pieces in any table we found. 0 if there are no tables
+std::vector<std::string> TBPaths;
+std::vector<TBTable*> TBTables; // WDL and DTZ tables, in pairs
+std::unordered_map<U64, std::pair<TBTable*, TBTable*>> TBTableMap; // material key -> (WDL, DTZ)
+std::mutex TBMappingMutex;
+
+/* Encoding tables, filled in initTablebases */
+int TBMapB1H1H7[64]; // squares below the a1-h8 diagonal -> 0..27
+int TBMapA1D1D4[64]; // squares in the a1-d1-d4 triangle -> 0..9
+int TBMapKK[10][64]; // two kings, the first in the a1-d1-d4 triangle -> 0..461
+int TBBinomial[6][64]; // [k][n] the number of ways to choose k squares from n
+int TBMapPawns[64]; // a2-h7 -> 0..47. the pawn with the highest value leads
+int TBLeadPawnIdx[6][64]; // [number of leading pawns][square of the leading pawn]
+int TBLeadPawnsSize[6][4]; // [number of leading pawns][file]
+
+const char TBPieceChars[] = "PNBRQK";
+
+/* Helpers */
+template <typename T> T readLittleEndian(const void *address) {
+    T value;
+    memcpy(&value, address, sizeof(T));
+    return value; // we only run on little endian machines
+}
+template <typename T> T readBigEndian(const void *address) {
+    const uint8_t *bytes = (const uint8_t *) address;
+    T value = 0;
+    for (int i = 0; i < (int) sizeof(T); i ++) value = (value << 8) | bytes[i];
+    return value;
+}
+inline int TBFile(int sq) {return sq & 7;}
+inline int TBRank(int sq) {return sq >> 3;}
+inline int offA1H8(int sq) {return TBRank(sq) - TBFile(sq);} // 0 on the a1-h8 diagonal, negative below it
+inline bool pawnsComp(int a, int b) {return TBMapPawns[a] < TBMapPawns[b];}
+inline int TBPieceCode(int pieceType, int side) {return pieceType + 1 + 8 * side;} // the files code pieces 1-6 (white), 9-14 (black)
+inline int TBPieceType(int code) {return (code & 7) - 1;}
+inline int TBPieceSide(int code) {return code >> 3;}
+
+U64 TBMaterialKey(const int counts[2][6]) {
+    // the counts of every piece, 4 bits each. it's unique, so there's no need for a zobrist style key
+    U64 key = 0;
+    for (int side = 0; side < 2; side ++) {
+        for (int pc = PAWN; pc <= KING; pc ++) {
+            key |= (U64) counts[side][pc] << (4 * (side * 6 + pc));
+        }
+    }
+    return key;
+}
+U64 TBMaterialKey(const TBPosition &pos) {
+    int counts[2][6];
+    for (int side = 0; side < 2; side ++) {
+        for (int pc = PAWN; pc <= KING; pc ++) counts[side][pc] = __builtin_popcountll(pos.pieces[side][pc]);
+    }
+    return TBMaterialKey(counts);
+}
+
+/* Reading the files */
+uint8_t* TBMapFile(TBTable &table) {
+    /* Maps a table into memory, and checks its magic number. Returns the data after the magic number, or nullptr */
+    const uint8_t magics[2][4] = {{0x71, 0xE8, 0x23, 0x5D}, {0xD7, 0x66, 0x0C, 0xA5}}; // WDL, DTZ
+    std::string fileName = table.code + (table.type == WDL ? ".rtbw" : ".rtbz");
+
+    for (std::string &path: TBPaths) {
+        std::string fullPath = path + "/" + fileName;
+
+#ifdef _WIN32
+        HANDLE fd = CreateFileA(fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (fd == INVALID_HANDLE_VALUE) continue;
+
+        DWORD sizeHigh;
+        DWORD sizeLow = GetFileSize(fd, &sizeHigh);
+        uint64_t size = ((uint64_t) sizeHigh << 32) | sizeLow;
+        if ((sizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) || (size % 64 != 16)) {
+            // every table is a 16 byte header followed by 64 byte aligned data
+            CloseHandle(fd);
+            continue;
+        }
+
+        HANDLE mappingHandle = CreateFileMapping(fd, nullptr, PAGE_READONLY, sizeHigh, sizeLow, nullptr);
+        CloseHandle(fd); // the mapping keeps the file open
+        if (!mappingHandle) continue;
+
+        void *mapped = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (!mapped) {
+            CloseHandle(mappingHandle);
+            continue;
+        }
+
+        uint8_t *data = (uint8_t *) mapped;
+        if (memcmp(data, magics[table.type], 4) != 0) {
+            UnmapViewOfFile(mapped);
+            CloseHandle(mappingHandle);
+            continue;
+        }
+
+        table.baseAddress = mapped;
+        table.mapping = size;
+        table.mappingHandle = mappingHandle;
+        return data + 4;
+#else
+        int fd = ::open(fullPath.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+
+        struct stat fileStats;
+        if ((fstat(fd, &fileStats) < 0) || (fileStats.st_size % 64 != 16)) {
+            // every table is a 16 byte header followed by 64 byte aligned data
+            ::close(fd);
+            continue;
+        }
+
+        void *mapped = mmap(nullptr, fileStats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) continue;
+        madvise(mapped, fileStats.st_size, MADV_RANDOM); // we jump around the file, so there's no point reading ahead
+
+        uint8_t *data = (uint8_t *) mapped;
+        if (memcmp(data, magics[table.type], 4) != 0) {
+            munmap(mapped, fileStats.st_size);
+            continue;
+        }
+
+        table.baseAddress = mapped;
+        table.mapping = fileStats.st_size;
+        return data + 4;
+#endif
+    }
+
+    return nullptr;
+}
+void TBSetSymlen(PairsData *d, Sym s, std::vector<bool> &visited) {
+    // works out how many values a symbol expands to, from its children
+    visited[s] = true; // the tree is acyclic, so we can mark it now
+    Sym sr = d->btree[s].right();
+    if (sr == 0xFFF) return; // a leaf
+
+    Sym sl = d->btree[s].left();
+    if (!visited[sl]) TBSetSymlen(d, sl, visited);
+    if (!visited[sr]) TBSetSymlen(d, sr, visited);
+
+    d->symlen[s] = d->symlen[sl] + d->symlen[sr] + 1;
+}
+uint8_t* TBSetSizes(PairsData *d, uint8_t *data) {
+    /* Reads the header of the compressed data */
+    d->flags = *data++;
+
+    if (d->flags & TBFlagSingleValue) {
+        // every position has the same value, which is stored in place of the symbol length
+        d->numBlocks = 0;
+        d->span = d->sparseIndexSize = 0;
+        d->minSymLen = *data++;
+        return data;
+    }
+
+    // the last groupIdx is the size of the table
+    uint64_t tableSize = d->groupIdx[std::find(d->groupLen, d->groupLen + TB_PIECES, 0) - d->groupLen];
+
+    d->sizeofBlock = (size_t) 1 << *data++;
+    d->span = (size_t) 1 << *data++;
+    d->sparseIndexSize = (tableSize + d->span - 1) / d->span;
+    int padding = *data++;
+    d->numBlocks = readLittleEndian<uint32_t>(data); data += sizeof(uint32_t);
+    d->blockLengthSize = d->numBlocks + padding; // padded, so the sparse index can't point out of range
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    d->lowestSym = (Sym *) data;
+    d->base64.assign(d->maxSymLen - d->minSymLen + 1, 0);
+
+    // Longer codes have lower values, so lowestSym[i] >= lowestSym[i + 1].
+    // From that we work out the lowest code of each length, and left align it, so we can find the length of a code by comparing against base64.
+    for (int i = (int) d->base64.size() - 2; i >= 0; i --) {
+        d->base64[i] = (d->base64[i + 1] + readLittleEndian<Sym>(&d->lowestSym[i]) - readLittleEndian<Sym>(&d->lowestSym[i + 1])) / 2;
+    }
+    for (size_t i = 0; i < d->base64.size(); i ++) {
+        d->base64[i] <<= 64 - i - d->minSymLen;
+    }
+
+    data += d->base64.size() * sizeof(Sym);
+    d->symlen.assign(readLittleEndian<uint16_t>(data), 0); data += sizeof(uint16_t);
+    d->btree = (LR *) data;
+
+    std::vector<bool> visited(d->symlen.size());
+    for (size_t sym = 0; sym < d->symlen.size(); sym ++) {
+        if (!visited[sym]) TBSetSymlen(d, sym, visited);
+    }
+
+    return data + d->symlen.size() * sizeof(LR) + (d->symlen.size() & 1);
+}
+uint8_t* TBSetDTZMap(TBTable &table, uint8_t *data, int maxFile) {
+    /* DTZ tables map the stored values to real distances, with a separate map for each WDL result */
+    if (table.type == WDL) return data;
+
+    table.map = data;
+    for (int f = 0; f <= maxFile; f ++) {
+        PairsData *d = table.get(0, f);
+        if (!(d->flags & TBFlagMapped)) continue;
+
+        if (d->flags & TBFlagWide) {
+            data += (uintptr_t) data & 1; // word alignment
+            for (int i = 0; i < 4; i ++) {
+                d->mapIdx[i] = (uint16_t *) data - (uint16_t *) table.map + 1;
+                data += 2 * readLittleEndian<uint16_t>(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; i ++) {
+                d->mapIdx[i] = data - table.map + 1;
+                data += *data + 1;
+            }
+        }
+    }
+
+    return data + ((uintptr_t) data & 1); // word alignment
+}
+void TBSetGroups(TBTable &table, PairsData *d, int order[2], int file) {
+    /* Splits the pieces into groups, and works out each group's multiplier in the index.
+     * The leading group is the kings and one other unique piece (or just the kings), or the leading pawns.
+     * After that, each run of identical pieces is a group.
+     * */
+    int n = 0, firstLen = table.hasPawns ? 0 : (table.hasUniquePieces ? 3 : 2);
+    d->groupLen[n] = 1;
+
+    for (int i = 1; i < table.pieceCount; i ++) {
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->groupLen[n] ++;
+        } else {
+            d->groupLen[++n] = 1;
+        }
+    }
+    d->groupLen[++n] = 0; // zero terminated
+
+    // The groups aren't always encoded in order. order[0] is where the leading group goes, and order[1] the other side's pawns.
+    bool pawnsOnBothSides = table.hasPawns && table.pawnCount[1];
+    int next = pawnsOnBothSides ? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - (pawnsOnBothSides ? d->groupLen[1] : 0);
+    uint64_t idx = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; k ++) {
+        if (k == order[0]) {
+            // leading pawns/ pieces
+            d->groupIdx[0] = idx;
+            idx *= table.hasPawns ? TBLeadPawnsSize[d->groupLen[0]][file] : (table.hasUniquePieces ? 31332 : 462);
+        } else if (k == order[1]) {
+            // the other side's pawns
+            d->groupIdx[1] = idx;
+            idx *= TBBinomial[d->groupLen[1]][48 - d->groupLen[0]];
+        } else {
+            // the rest of the pieces
+            d->groupIdx[next] = idx;
+            idx *= TBBinomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next ++];
+        }
+    }
+
+    d->groupIdx[n] = idx;
+}
+void TBSetup(TBTable &table, uint8_t *data) {
+    /* Reads a table's header, and points each part of it at the right place in the file */
+    data ++; // the first byte stores flags (split, has pawns), which we already know
+
+    int sides = (table.type == WDL && table.key != table.key2) ? 2 : 1;
+    int maxFile = table.hasPawns ? 3 : 0;
+    bool pawnsOnBothSides = table.hasPawns && table.pawnCount[1];
+
+    for (int f = 0; f <= maxFile; f ++) {
+        for (int i = 0; i < sides; i ++) *table.get(i, f) = PairsData();
+
+        int order[2][2] = {{*data & 0xF, pawnsOnBothSides ? *(data + 1) & 0xF : 0xF},
+                           {*data >> 4, pawnsOnBothSides ? *(data + 1) >> 4 : 0xF}};
+        data += 1 + pawnsOnBothSides;
+
+        for (int k = 0; k < table.pieceCount; k ++, data ++) {
+            for (int i = 0; i < sides; i ++) table.get(i, f)->pieces[k] = i ? *data >> 4 : *data & 0xF;
+        }
+
+        for (int i = 0; i < sides; i ++) TBSetGroups(table, table.get(i, f), order[i], f);
+    }
+
+    data += (uintptr_t) data & 1; // word alignment
+
+    for (int f = 0; f <= maxFile; f ++) {
+        for (int i = 0; i < sides; i ++) data = TBSetSizes(table.get(i, f), data);
+    }
+
+    data = TBSetDTZMap(table, data, maxFile);
+
+    for (int f = 0; f <= maxFile; f ++) {
+        for (int i = 0; i < sides; i ++) {
+            PairsData *d = table.get(i, f);
+            d->sparseIndex = (SparseEntry *) data;
+            data += d->sparseIndexSize * sizeof(SparseEntry);
+        }
+    }
+    for (int f = 0; f <= maxFile; f ++) {
+        for (int i = 0; i < sides; i ++) {
+            PairsData *d = table.get(i, f);
+            d->blockLength = (uint16_t *) data;
+            data += d->blockLengthSize * sizeof(uint16_t);
+        }
+    }
+    for (int f = 0; f <= maxFile; f ++) {
+        for (int i = 0; i < sides; i ++) {
+            data = (uint8_t *) (((uintptr_t) data + 0x3F) & ~(uintptr_t) 0x3F); // 64 byte alignment
+            PairsData *d = table.get(i, f);
+            d->data = data;
+            data += (size_t) d->numBlocks * d->sizeofBlock;
+        }
+    }
+}
+bool TBMapped(TBTable &table) {
+    /* Maps the table the first time it's probed. Several search threads could get here at once, so it's locked */
+    if (table.ready.load(std::memory_order_acquire)) return table.baseAddress != nullptr;
+
+    std::lock_guard<std::mutex> lock(TBMappingMutex);
+    if (table.ready.load(std::memory_order_relaxed)) return table.baseAddress != nullptr;
+
+    uint8_t *data = TBMapFile(table);
+    if (data) TBSetup(table, data);
+
+    table.ready.store(true, std::memory_order_release);
+    return table.baseAddress != nullptr;
+}
+
+/* Decompression */
+int TBDecompressPairs(PairsData *d, uint64_t idx) {
+    /* Finds the value stored at an index
+     * How does it work?
+     * 1. The sparse index gives a block and offset every span values. We start from the closest one and walk to the block that holds idx.
+     * 2. Read the block's canonical Huffman codes one by one. Each symbol stands for symlen + 1 values, so we skip symbols until we reach ours.
+     * 3. Walk down the symbol's pair tree to the value.
+     * */
+    if (d->flags & TBFlagSingleValue) return d->minSymLen;
+
+    // * 1.
+    uint32_t k = idx / d->span;
+    uint32_t block = readLittleEndian<uint32_t>(&d->sparseIndex[k].block);
+    int offset = readLittleEndian<uint16_t>(&d->sparseIndex[k].offset);
+
+    // the sparse entry is for the middle of the span
+    offset += (int) (idx % d->span) - (int) (d->span / 2);
+
+    while (offset < 0) offset += d->blockLength[--block] + 1;
+    while (offset > d->blockLength[block]) offset -= d->blockLength[block ++] + 1;
+
+    // * 2.
+    uint32_t *ptr = (uint32_t *) (d->data + (uint64_t) block * d->sizeofBlock);
+    uint64_t buf64 = readBigEndian<uint64_t>(ptr);
+    ptr += 2;
+    int buf64Size = 64;
+    Sym sym;
+
+    while (true) {
+        int len = 0; // the code length - minSymLen
+        while (buf64 < d->base64[len]) len ++;
+
+        // codes of the same length are consecutive, so the offset from the lowest code gives the symbol
+        sym = (buf64 - d->base64[len]) >> (64 - len - d->minSymLen);
+        sym += readLittleEndian<Sym>(&d->lowestSym[len]);
+
+        if (offset < d->symlen[sym] + 1) break;
+
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+
+        if (buf64Size <= 32) {
+            // refill the buffer
+            buf64Size += 32;
+            buf64 |= (uint64_t) readBigEndian<uint32_t>(ptr ++) << (64 - buf64Size);
+        }
+    }
+
+    // * 3.
+    while (d->symlen[sym]) {
+        Sym left = d->btree[sym].left();
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = d->btree[sym].right();
+        }
+    }
+
+    return d->btree[sym].left();
+}
+int TBMapScore(TBTable &table, int file, int value, WDLScore wdl) {
+    /* Turns a decompressed value into a result */
+    if (table.type == WDL) return value - 2;
+
+    // DTZ: map the value, then convert it to plies if it's stored in moves
+    const int WDLMap[] = {1, 3, 0, 2, 0};
+    PairsData *d = table.get(0, file);
+
+    if (d->flags & TBFlagMapped) {
+        if (d->flags & TBFlagWide) {
+            value = ((uint16_t *) table.map)[d->mapIdx[WDLMap[wdl + 2]] + value];
+        } else {
+            value = table.map[d->mapIdx[WDLMap[wdl + 2]] + value];
+        }
+    }
+
+    if ((wdl == WDLWin && !(d->flags & TBFlagWinPlies)) ||
+        (wdl == WDLLoss && !(d->flags & TBFlagLossPlies)) ||
+        (wdl == WDLCursedWin) || (wdl == WDLBlessedLoss)) {
+        value *= 2;
+    }
+
+    return value + 1;
+}
+
+/* Probing a table */
+uint64_t TBIndex(TBTable &table, PairsData *d, int *squares, int *pieces, int size, int leadPawnsCnt) {
+    /* Turns the pieces into the index of the position in the table. The leading pawns (if any) come first in squares, and the colours are already swapped if needed */
+    // put the pieces in the order they're encoded in
+    for (int i = leadPawnsCnt; i < size - 1; i ++) {
+        for (int j = i + 1; j < size; j ++) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    // mirror so the leading piece is on files a-d
+    if (TBFile(squares[0]) > 3) {
+        for (int i = 0; i < size; i ++) squares[i] ^= 7;
+    }
+
+    uint64_t idx;
+    if (table.hasPawns) {
+        // the leading pawns, in ascending order of MapPawns
+        idx = TBLeadPawnIdx[leadPawnsCnt][squares[0]];
+        std::stable_sort(squares + 1, squares + leadPawnsCnt, pawnsComp);
+        for (int i = 1; i < leadPawnsCnt; i ++) idx += TBBinomial[i][TBMapPawns[squares[i]]];
+    } else {
+        // without pawns we can also mirror so the leading piece is on ranks 1-4, and below the a1-h8 diagonal
+        if (TBRank(squares[0]) > 3) {
+            for (int i = 0; i < size; i ++) squares[i] ^= 56;
+        }
+        for (int i = 0; i < d->groupLen[0]; i ++) {
+            if (!offA1H8(squares[i])) continue;
+
+            if (offA1H8(squares[i]) > 0) {
+                for (int j = i; j < size; j ++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+
+        if (table.hasUniquePieces) {
+            // the kings and a unique piece are encoded together, depending on which of them are on the diagonal
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+            if (offA1H8(squares[0])) {
+                idx = (TBMapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            } else if (offA1H8(squares[1])) {
+                idx = (6 * 63 + TBRank(squares[0]) * 28 + TBMapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            } else if (offA1H8(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + TBRank(squares[0]) * 7 * 28 + (TBRank(squares[1]) - adjust1) * 28 + TBMapB1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + TBRank(squares[0]) * 7 * 6 + (TBRank(squares[1]) - adjust1) * 6 + (TBRank(squares[2]) - adjust2);
+            }
+        } else {
+            // just the kings
+            idx = TBMapKK[TBMapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    // the rest of the groups, each as a combination of the squares left
+    idx *= d->groupIdx[0];
+    int *groupSq = squares + d->groupLen[0];
+    bool remainingPawns = table.hasPawns && table.pawnCount[1];
+
+    for (int next = 1; d->groupLen[next]; next ++) {
+        std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+        uint64_t n = 0;
+
+        for (int i = 0; i < d->groupLen[next]; i ++) {
+            // squares taken by an earlier group don't count
+            int adjust = std::count_if(squares, groupSq, [&](int s) {return groupSq[i] > s;});
+            n += TBBinomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+
+    return idx;
+}
+int TBProbeTable(const TBPosition &pos, TBType type, TBProbeState &result, WDLScore wdl = WDLDraw) {
+    /* Looks up a position in a table. It has to be a real lookup: the caller deals with en-passant and zeroing moves.
+     * Returns a WDLScore for WDL tables, or the DTZ in plies for DTZ tables.
+     * */
+    int numPieces = 0;
+    for (int side = 0; side < 2; side ++) {
+        for (int pc = PAWN; pc <= KING; pc ++) numPieces += __builtin_popcountll(pos.pieces[side][pc]);
+    }
+    if (numPieces == 2) return WDLDraw; // KvK
+
+    U64 materialKey = TBMaterialKey(pos);
+    auto found = TBTableMap.find(materialKey);
+    if (found == TBTableMap.end()) {
+        result = TB_FAIL;
+        return 0;
+    }
+    TBTable *table = (type == WDL) ? found->second.first : found->second.second;
+    if (!TBMapped(*table)) {
+        result = TB_FAIL;
+        return 0;
+    }
+
+    int squares[TB_PIECES], pieces[TB_PIECES];
+    int size = 0, leadPawnsCnt = 0, tbFile = 0;
+    U64 leadPawns = 0;
+
+    // The tables are stored with the stronger side as white. If both sides have the same pieces, only white to move is stored.
+    // In either case we may need to swap the colours, and flip the board.
+    bool symmetricBlackToMove = (table->key == table->key2) && (pos.side == BLACK);
+    bool blackStronger = (materialKey != table->key);
+    bool flip = symmetricBlackToMove || blackStronger;
+    int flipColor = flip ? 8 : 0, flipSquares = flip ? 56 : 0;
+    int stm = flip ^ (pos.side == BLACK);
+
+    // With pawns, there are four tables, one for each file (a-d) of the leading pawn: the one closest to the edge, and then the lowest rank.
+    if (table->hasPawns) {
+        int leadCode = table->get(0, 0)->pieces[0] ^ flipColor;
+        U64 b = leadPawns = pos.pieces[TBPieceSide(leadCode)][PAWN];
+        while (b) {
+            squares[size ++] = __builtin_ctzll(b) ^ flipSquares;
+            b &= b - 1;
+        }
+        leadPawnsCnt = size;
+
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCnt, pawnsComp));
+        tbFile = std::min(TBFile(squares[0]), 7 - TBFile(squares[0]));
+    }
+
+    // DTZ tables only store one side to move
+    if (type == DTZ) {
+        PairsData *d = table->get(stm, tbFile);
+        if (((d->flags & TBFlagSTM) != stm) && !((table->key == table->key2) && !table->hasPawns)) {
+            result = TB_CHANGE_STM;
+            return 0;
+        }
+    }
+
+    // now the rest of the pieces
+    for (int side = 0; side < 2; side ++) {
+        for (int pc = PAWN; pc <= KING; pc ++) {
+            U64 b = pos.pieces[side][pc] & ~leadPawns;
+            while (b) {
+                squares[size] = __builtin_ctzll(b) ^ flipSquares;
+                pieces[size ++] = TBPieceCode(pc, side) ^ flipColor;
+                b &= b - 1;
+            }
+        }
+    }
+
+    PairsData *d = table->get(stm, tbFile);
+    uint64_t idx = TBIndex(*table, d, squares, pieces, size, leadPawnsCnt);
+
+    return TBMapScore(*table, tbFile, TBDecompressPairs(d, idx), wdl);
+}
+
+/* Initialisation */
+void TBAddTable(const std::string &white, const std::string &black) {
+    /* Adds a table if its WDL file exists. white and black are the pieces of each side (without the king) e.g. "R", "" */
+    std::string code = "K" + white + "vK" + black;
+
+    bool exists = false;
+    for (std::string &path: TBPaths) {
+        struct stat fileStats;
+        if (stat((path + "/" + code + ".rtbw").c_str(), &fileStats) == 0) exists = true;
+    }
+    if (!exists) return;
+
+    int counts[2][6] = {}, swapped[2][6] = {};
+    counts[WHITE][KING] = counts[BLACK][KING] = 1;
+    for (char c: white) counts[WHITE][std::string(TBPieceChars).find(c)] ++;
+    for (char c: black) counts[BLACK][std::string(TBPieceChars).find(c)] ++;
+    for (int pc = PAWN; pc <= KING; pc ++) {
+        swapped[WHITE][pc] = counts[BLACK][pc];
+        swapped[BLACK][pc] = counts[WHITE][pc];
+    }
+
+    TBTable *tables[2];
+    for (TBType type: {WDL, DTZ}) {
+        TBTable *table = new TBTable();
+        table->type = type;
+        table->code = code;
+        table->key = TBMaterialKey(counts);
+        table->key2 = TBMaterialKey(swapped);
+        table->pieceCount = white.size() + black.size() + 2;
+        table->hasPawns = counts[WHITE][PAWN] || counts[BLACK][PAWN];
+        for (int side = 0; side < 2; side ++) {
+            for (int pc = PAWN; pc < KING; pc ++) {
+                if (counts[side][pc] == 1) table->hasUniquePieces = true;
+            }
+        }
+
+        // the leading colour is the side with fewer pawns (but some), as that compresses better
+        bool whiteLeads = !counts[BLACK][PAWN] || (counts[WHITE][PAWN] && counts[BLACK][PAWN] >= counts[WHITE][PAWN]);
+        table->pawnCount[0] = whiteLeads ? counts[WHITE][PAWN] : counts[BLACK][PAWN];
+        table->pawnCount[1] = whiteLeads ? counts[BLACK][PAWN] : counts[WHITE][PAWN];
+
+        tables[type] = table;
+        TBTables.push_back(table);
+    }
+
+    TBTableMap[tables[WDL]->key] = {tables[WDL], tables[DTZ]};
+    TBTableMap[tables[WDL]->key2] = {tables[WDL], tables[DTZ]};
+    TBLargest = std::max(TBLargest, tables[WDL]->pieceCount);
+}
+void TBPieceSets(std::vector<std::string> &sets, std::string current, int maxPiece, int piecesLeft) {
+    // every set of pieces (without the king) with at most piecesLeft pieces, in descending order e.g. "QRP"
+    sets.push_back(current);
+    if (!piecesLeft) return;
+
+    for (int pc = maxPiece; pc >= PAWN; pc --) {
+        TBPieceSets(sets, current + TBPieceChars[pc], pc, piecesLeft - 1);
+    }
+}
+void freeTablebases() {
+    for (TBTable *table: TBTables) {
+#ifdef _WIN32
+        if (table->baseAddress) {
+            UnmapViewOfFile(table->baseAddress);
+            CloseHandle(table->mappingHandle);
+        }
+#else
+        if (table->baseAddress) munmap(table->baseAddress, table->mapping);
+#endif
+        delete table;
+    }
+    TBTables.clear();
+    TBTableMap.clear();
+    TBPaths.clear();
+    TBLargest = 0;
+}
+void initTablebases(const std::string &paths) {
+    /* Looks for tables in the given directories (separated by ':', or ';' on windows). An empty path turns tablebases off */
+    freeTablebases();
+
+    // the encoding tables
+    int code = 0;
+    for (int sq = 0; sq < 64; sq ++) {
+        if (offA1H8(sq) < 0) TBMapB1H1H7[sq] = code ++;
+    }
+
+    code = 0;
+    std::vector<int> diagonal;
+    for (int sq = 0; sq < 64; sq ++) {
+        if (TBFile(sq) > 3 || TBRank(sq) > 3) continue;
+        if (offA1H8(sq) < 0) {
+            TBMapA1D1D4[sq] = code ++;
+        } else if (!offA1H8(sq)) {
+            diagonal.push_back(sq);
+        }
+    }
+    for (int sq: diagonal) TBMapA1D1D4[sq] = code ++; // the diagonal squares go last
+
+    // two kings: the first in the a1-d1-d4 triangle. if it's on the diagonal, the second can't be above the diagonal
+    code = 0;
+    std::vector<std::pair<int, int>> bothOnDiagonal;
+    for (int idx = 0; idx < 10; idx ++) {
+        for (int s1 = 0; s1 < 64; s1 ++) {
+            if (TBFile(s1) > 3 || TBRank(s1) > 3 || offA1H8(s1) > 0 || TBMapA1D1D4[s1] != idx) continue;
+            if (!idx && s1 != 1) continue; // b1 is mapped to 0
+
+            for (int s2 = 0; s2 < 64; s2 ++) {
+                if ((abs(TBFile(s1) - TBFile(s2)) <= 1) && (abs(TBRank(s1) - TBRank(s2)) <= 1)) continue; // the kings touch
+                if (!offA1H8(s1) && offA1H8(s2) > 0) continue;
+
+                if (!offA1H8(s1) && !offA1H8(s2)) {
+                    bothOnDiagonal.emplace_back(idx, s2);
+                } else {
+                    TBMapKK[idx][s2] = code ++;
+                }
+            }
+        }
+    }
+    for (auto &p: bothOnDiagonal) TBMapKK[p.first][p.second] = code ++;
+
+    memset(TBBinomial, 0, sizeof(TBBinomial));
+    TBBinomial[0][0] = 1;
+    for (int n = 1; n < 64; n ++) {
+        for (int k = 0; k < 6 && k <= n; k ++) {
+            TBBinomial[k][n] = (k > 0 ? TBBinomial[k - 1][n - 1] : 0) + (k < n ? TBBinomial[k][n - 1] : 0);
+        }
+    }
+
+    // MapPawns counts down from a2, so pawns near the edge and on low ranks lead
+    int availableSquares = 47;
+    for (int leadPawnsCnt = 1; leadPawnsCnt <= 5; leadPawnsCnt ++) {
+        for (int f = 0; f < 4; f ++) {
+            int idx = 0;
+            for (int r = 1; r <= 6; r ++) {
+                int sq = r * 8 + f;
+                if (leadPawnsCnt == 1) {
+                    TBMapPawns[sq] = availableSquares --;
+                    TBMapPawns[sq ^ 7] = availableSquares --;
+                }
+                TBLeadPawnIdx[leadPawnsCnt][sq] = idx;
+                idx += TBBinomial[leadPawnsCnt - 1][TBMapPawns[sq]];
+            }
+            TBLeadPawnsSize[leadPawnsCnt][f] = idx;
+        }
+    }
+
+    // split the paths
+#ifdef _WIN32
+    const char separator = ';';
+#else
+    const char separator = ':';
+#endif
+    std::string path;
+    for (char c: paths + separator) {
+        if (c == separator) {
+            if (!path.empty()) TBPaths.push_back(path);
+            path.clear();
+        } else {
+            path += c;
+        }
+    }
+    if (TBPaths.empty()) return;
+
+    // look for every table. each pair of piece sets is tried both ways round, as we don't know which side the file puts first
+    std::vector<std::string> sets;
+    TBPieceSets(sets, "", QUEEN, TB_PIECES - 2);
+    for (size_t i = 0; i < sets.size(); i ++) {
+        for (size_t j = i; j < sets.size(); j ++) {
+            if (sets[i].size() + sets[j].size() > TB_PIECES - 2) continue;
+            if (sets[i].empty() && sets[j].empty()) continue; // KvK is always a draw
+
+            size_t before = TBTables.size();
+            TBAddTable(sets[i], sets[j]);
+            if ((TBTables.size() == before) && (i != j)) TBAddTable(sets[j], sets[i]);
+        }
+    }
+}
+
+#endif //SEARCH_SYZYGY_CPP
@@ -0,0 +1,209 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include "../SearchController.h"
+#include "syzygy.cpp"
+
+#ifndef SEARCH_TBPROBE_CPP
+#define SEARCH_TBPROBE_CPP
+
+/* Probing the tablebases through the board
+ * The tables don't store positions where a capture (or en-passant) is the best move, as those are solved by the smaller table.
+ * So before looking a position up, we try the captures ourselves. For DTZ we also need to try pawn moves, as they zero the counter too.
+ * */
+inline int signOf(int x) {return (x > 0) - (x < 0);}
+inline int dtzBeforeZeroing(int wdl) {
+    // the DTZ of a position where the best move zeroes the counter
+    return wdl == WDLWin ? 1 :
+           wdl == WDLCursedWin ? 101 :
+           wdl == WDLBlessedLoss ? -101 :
+           wdl == WDLLoss ? -1 : 0;
+}
+
+TBPosition SearchController::getTBPosition() {
+    // the tables count squares from a1, and ours from a8, so each bitboard is byte swapped
+    TBPosition pos;
+    for (short side: {WHITE, BLACK}) {
+        for (short pc = PAWN; pc <= KING; pc ++) {
+            pos.pieces[side][pc] = __builtin_bswap64(getPieces(pc, side));
+        }
+    }
+    pos.side = currentSide;
+    return pos;
+}
+int SearchController::probeWDLSearch(bool checkZeroingMoves, TBProbeState &result) {
+    /* Works out the WDL of the position.
+     * How does it work?
+     * 1. Try every capture (and pawn move, if checkZeroingMoves). If one wins, we're done.
+     * 2. If every legal move was tried, the best of them is the answer. Otherwise look the position up.
+     * 3. If a capture is at least as good as the table says, the table value might be a 'don't care', so the capture's score is used.
+     * */
+    int bestValue = WDLLoss;
+    MoveList moves = getMoveList();
+    int moveCount = 0;
+
+    // * 1.
+    for (Move move: moves) {
+        short flag = (move & flagMask) >> 14, fromType = (move & fromTypeMask) >> 16;
+        bool capture = (getTooPiece(move) != EMPTY) && (flag != CASTLING);
+        if (!capture && (!checkZeroingMoves || fromType != PAWN)) continue;
+
+        moveCount ++;
+        makeMove(move);
+        int value = -probeWDLSearch(false, result);
+        unMakeMove();
+        if (result == TB_FAIL) return WDLDraw;
+
+        if (value > bestValue) {
+            bestValue = value;
+            if (value >= WDLWin) {
+                result = TB_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // * 2.
+    bool noMoreMoves = moveCount && (moveCount == (int) moves.size());
+    int value;
+    if (noMoreMoves) {
+        value = bestValue;
+    } else {
+        value = TBProbeTable(getTBPosition(), WDL, result);
+        if (result == TB_FAIL) return WDLDraw;
+    }
+
+    // * 3.
+    if (bestValue >= value) {
+        result = (bestValue > WDLDraw || noMoreMoves) ? TB_ZEROING_BEST_MOVE : TB_OK;
+        return bestValue;
+    }
+
+    result = TB_OK;
+    return value;
+}
+int SearchController::probeWDL(TBProbeState &result) {
+    result = TB_OK;
+    return probeWDLSearch(false, result);
+}
+int SearchController::probeDTZ(TBProbeState &result) {
+    /* Works out the DTZ of the position, in plies. It's positive if we win, and 100 more for cursed wins (or less for blessed losses).
+     * DTZ tables are only stored for one side to move. If it's the other side, we search one ply and take the best move's DTZ.
+     * */
+    result = TB_OK;
+    int wdl = probeWDLSearch(true, result);
+    if (result == TB_FAIL || wdl == WDLDraw) return 0; // DTZ tables don't store draws
+
+    // the table stores a 'don't care' value if the best move zeroes the counter
+    if (result == TB_ZEROING_BEST_MOVE) return dtzBeforeZeroing(wdl);
+
+    int dtz = TBProbeTable(getTBPosition(), DTZ, result, (WDLScore) wdl);
+    if (result == TB_FAIL) return 0;
+    if (result != TB_CHANGE_STM) return (dtz + 100 * (wdl == WDLBlessedLoss || wdl == WDLCursedWin)) * signOf(wdl);
+
+    // the table is for the other side to move, so search one ply for the move that gets the result quickest
+    int minDTZ = 0xFFFF;
+    for (Move move: getMoveList()) {
+        short fromType = (move & fromTypeMask) >> 16, flag = (move & flagMask) >> 14;
+        bool zeroing = ((getTooPiece(move) != EMPTY) && (flag != CASTLING)) || (fromType == PAWN);
+
+        makeMove(move);
+
+        // for zeroing moves we want the DTZ before the move, so we just need the sign of the result
+        dtz = zeroing ? -dtzBeforeZeroing(probeWDLSearch(false, result)) : -probeDTZ(result);
+
+        // a mating move has a DTZ of 1
+        if (dtz == 1) {
+            genMoves();
+            if (inCheck && combinedMoveList.empty()) minDTZ = 1;
+        }
+
+        // zeroing moves already count the move
+        if (!zeroing) dtz += signOf(dtz);
+
+        // skip draws, and if we are winning only take wins
+        if ((dtz < minDTZ) && (signOf(dtz) == signOf(wdl))) minDTZ = dtz;
+
+        unMakeMove();
+        if (result == TB_FAIL) return 0;
+    }
+
+    // with no legal moves, we've been mated
+    return minDTZ == 0xFFFF ? -1 : minDTZ;
+}
+bool SearchController::probeRoot(MoveList &moves) {
+    /* Filters the root moves with the tablebases, so the search only looks at the moves that keep the best result.
+     * How does it work?
+     * 1. Rank each move by its DTZ (or just its WDL if we don't have the DTZ table).
+     *    Wins are ranked by how quickly they zero the counter, so we always make progress. Losses by how long they hold out.
+     *    With the fifty move rule, wins and losses that can't be converted in time are ranked as draws.
+     * 2. Keep the moves with the best rank. The search picks between them.
+     * Returns false if any probe fails, in which case the moves are left alone.
+     * */
+    if (CastleRights || (count(occupiedSquares) > TBLargest)) return false;
+
+    bool useRule50 = searchParameters->syzygy50MoveRule;
+    int halfMoves = halfMoveClock;
+    TBProbeState result;
+
+    for (bool useDTZ: {true, false}) {
+        vector<int> ranks;
+        bool failed = false;
+
+        // * 1.
+        for (Move move: moves) {
+            makeMove(move);
+
+            int rank;
+            if (useDTZ) {
+                int dtz;
+                if (halfMoveClock == 0) {
+                    // a zeroing move, so it's just the WDL
+                    dtz = dtzBeforeZeroing(-probeWDL(result));
+                } else {
+                    dtz = -probeDTZ(result);
+                    dtz = dtz > 0 ? dtz + 1 : (dtz < 0 ? dtz - 1 : 0);
+                }
+
+                // a mating move has a DTZ of 1
+                if (dtz == 2) {
+                    genMoves();
+                    if (inCheck && combinedMoveList.empty()) dtz = 1;
+                }
+
+                if (dtz > 0) {
+                    rank = (useRule50 && dtz + halfMoves > 100) ? 0 : 1000 - dtz;
+                } else if (dtz < 0) {
+                    rank = (useRule50 && -dtz + halfMoves > 100) ? 0 : -1000 - dtz;
+                } else {
+                    rank = 0;
+                }
+            } else {
+                int wdl = -probeWDL(result);
+                rank = (useRule50 && abs(wdl) == 1) ? 0 : wdl;
+            }
+
+            unMakeMove();
+            if (result == TB_FAIL) {
+                failed = true;
+                break;
+            }
+            ranks.push_back(rank);
+        }
+        if (failed) continue;
+
+        // * 2.
+        int bestRank = *std::max_element(ranks.begin(), ranks.end());
+        MoveList bestMoves;
+        for (size_t i = 0; i < moves.size(); i ++) {
+            if (ranks[i] == bestRank) bestMoves.push_back(moves[i]);
+        }
+        moves = bestMoves;
+        return true;
+    }
+
+    return false;
+}
+
+#endif //SEARCH_TBPROBE_CPP
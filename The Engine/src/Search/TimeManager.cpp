@@ -0,0 +1,72 @@
+//
+// Created by Noah Joubert on 19/10/2026.
+//
+
+#include "../types.h"
+#include "search.h"
+
+#ifndef SEARCH_TIMEMANAGER_CPP
+#define SEARCH_TIMEMANAGER_CPP
+
+/* What does the time manager do?
+ * It decides how long we should spend on a move, from the clock information in the UCI go command.
+ * It gives two times:
+    * The optimum time. Once this has passed we don't start another iteration. It's scaled by the search depending on
+      how stable the best move is, and whether the score is dropping.
+    * The maximum time. Once this has passed we abort the search, even part way through an iteration.
+ * */
+class TimeManager {
+    Timer timer; // started when the search starts (or when we get a ponderhit)
+    float optimumTime = 0, maximumTime = 0; // in seconds
+    bool timeLimited = false; // whether we have to worry about time at all e.g. not for go infinite/ go depth
+
+public:
+    void init(SearchLimits &limits, short side, SearchParameters &params) {
+        /* How does it work?
+         * 1. If we are given a fixed time per move, just use that (minus the overhead).
+         * 2. If we have a clock, spread the time left over the moves left, and add most of the increment.
+         *    We never plan to use more than a fraction of what's left on the clock.
+         * 3. If we have nothing to go on (e.g. debug mode), use the minimum search time.
+         * */
+        restart();
+        timeLimited = true;
+
+        float overhead = params.moveOverhead / 1000.0;
+        if (limits.moveTime) {
+            // * 1.
+            optimumTime = std::max(0.001f, limits.moveTime / 1000.0f - overhead);
+            maximumTime = optimumTime;
+        } else if (limits.clock) {
+            // * 2.
+            float timeLeft = limits.time[side] / 1000.0f, increment = limits.increment[side] / 1000.0f;
+            int movesToGo = limits.movesToGo ? std::min(limits.movesToGo, params.defaultMovesToGo) : params.defaultMovesToGo;
+
+            float available = std::max(0.001f, timeLeft - overhead); // the most we could possibly use
+            optimumTime = timeLeft / movesToGo + increment * 0.75f;
+            maximumTime = std::min(optimumTime * params.maxTimeScale, available * params.maxTimeFraction);
+            optimumTime = std::min(optimumTime, maximumTime);
+        } else if (limits.infinite || limits.depth || limits.nodes) {
+            timeLimited = false;
+        } else {
+            // * 3.
+            optimumTime = params.minSearchTime;
+            maximumTime = params.minSearchTime * params.maxTimeScale;
+        }
+    }
+    void restart() {
+        timer = Timer();
+    }
+    float elapsed() {
+        return timer.end();
+    }
+    bool outOfTime() {
+        // see if we must abort the search right now
+        return timeLimited && (elapsed() >= maximumTime);
+    }
+    bool shouldStopIterating(float timeScale) {
+        // see if we shouldn't start another iteration. timeScale stretches/ shrinks the optimum time
+        return timeLimited && (elapsed() >= std::min(optimumTime * timeScale, maximumTime));
+    }
+};
+
+#endif //SEARCH_TIMEMANAGER_CPP
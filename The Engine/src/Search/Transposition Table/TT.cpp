@@ -5,11 +5,13 @@
 #include "zobrist.h"
 #include "../search.h"
 #include <tgmath.h> // for log2
+#include <thread>
 
 #ifndef SEARCH_TT_CPP
 #define SEARCH_TT_CPP
 
 typedef uint16_t Zob16; // used to just hold the last 16 bits of a zobrist key to save memory
+#define NO_STATIC_EVAL INT16_MIN // stored when the position has no static evaluation (e.g. it's in check)
 
 // these flags are used to identify whether an evaluation is exact, or an alpha beta cut-off.
 
@@ -22,9 +24,10 @@ struct TTNode {
     Move move = 0; // the move code of the best move found
     Zob16 key = 0; // top half of the zobrist key, used to identify a chess position.
     int16_t eval = 0; // evaluation of this node
+    int16_t staticEval = NO_STATIC_EVAL; // the static evaluation of the position, so it doesn't need working out again
     U8 depth = 0; // the depth at which the position was searched
     U8 flag = 0; // holds whether the evaluation is exact, or an alpha-beta cut off
-    U8 age = 0; // holds the moveNumber at which this search was done
+    U8 age = 0; // holds the TT generation (i.e. which search) this entry was written in
 };
 
 /* The actual transposition table. It is essentially a wrapper around an array of TTNodes.
@@ -47,6 +50,11 @@ class TranspositionTable {
     int replaceDepth; // the extra depth needed to replace a node
     int replaceAge; // the extra age needed to replace a node
 
+    /* The generation is bumped at the start of every search, rather than clearing the table.
+     * Entries from old generations are still valid (they are keyed by zobrist), they just become easier to replace.
+     * */
+    U8 generation = 0;
+
     TTNode *table;  // array which holds the transposition table
 public:
     /* These stats keep track of the access statistics */
@@ -109,23 +117,25 @@ public:
         return node;
     }
 
-    void set(Zobrist key, Move &move, int &depth, int flag, short age, int &eval) {
+    void set(Zobrist key, Move &move, int &depth, int flag, int &eval, int staticEval) {
         // takes in the results of a search and replaces the node if necessary
         TTNode* node = find(key);
 
         Zob16 shiftedKey = toZob16(key);
+        U8 nodeAge = generation - node->age; // how many searches ago this node was written (wraps around safely)
 
         totalSetCalls ++;
 
         if (    (   node->key == 0  ) ||
-                (   (node->key == shiftedKey)  &&   (depth > node->depth )   ) ||
-                (   (node->key != shiftedKey)  &&   (depth - node->depth >= replaceDepth) || (age - node->age >= replaceAge)))
+                (   (node->key == shiftedKey)  &&   ((depth > node->depth) || (nodeAge > 0))   ) ||
+                (   (node->key != shiftedKey)  &&   ((depth - node->depth >= replaceDepth) || (nodeAge >= replaceAge))   ))
         {
             // the node will be overwritten if
             // 1. It is empty
             // 2. The node has the same zobrist key (i.e. it should represent the same position, forgetting collisions exist).
+                // We overwrite if we searched deeper, or if the node is left over from a previous search.
             // 3. the node has a different zobrist key (i.e. we are overwriting AND
-                // We have three factors to consider: the node type, the age the depth.
+                // We have two factors to consider: the age and the depth.
 
             totalNodesSet ++;
 
@@ -142,10 +152,18 @@ public:
             node->move = move;
             node->depth = depth;
             node->flag = flag;
-            node->age = age;
+            node->age = generation;
             node->eval = (int16_t) eval;
+            node->staticEval = (int16_t) staticEval;
+        } else if ((node->key == shiftedKey) && (node->staticEval == NO_STATIC_EVAL)) {
+            // we keep the deeper search, but the static evaluation is still worth having
+            node->staticEval = (int16_t) staticEval;
         }
     }
+    void newSearch() {
+        // called at the start of each search. this ages every entry in the table without touching it
+        generation ++;
+    }
     void clearTotals() {
         totalProbeCalls = 0, totalProbeFound = 0; // the number of probes to the TT
         totalSetCalls = 0; // total number of calls to add a search to the TT
@@ -155,11 +173,26 @@ public:
         totalTTMovesFound = 0, totalTTMovesInMoveList = 0; // checks whether the move returned is in the move-list (or we have a full on collision)
     }
     void clear() {
-        // init the table
-        for (int i = 0; i < TTsize; i++) {
-            TTNode node;
-            table[i] = node;
+        /* Reset every entry in the table
+         * This touches the whole table, so it should only be done between games (ucinewgame), not between moves.
+         * The table is split into chunks which are reset in parallel.
+         * */
+        long numThreads = std::max(1u, std::thread::hardware_concurrency());
+        long chunkSize = (TTsize + numThreads - 1) / numThreads;
+
+        vector<std::thread> threads;
+        for (long start = 0; start < TTsize; start += chunkSize) {
+            long end = std::min(start + chunkSize, TTsize);
+            threads.emplace_back([this, start, end]() {
+                std::fill(table + start, table + end, TTNode());
+            });
         }
+        for (std::thread &t: threads) {
+            t.join();
+        }
+
+        generation = 0;
+        totalUniqueNodes = 0;
     }
     int getSize() {
         return TTsize;
@@ -6,78 +6,283 @@
 #include "search.h"
 #include "SearchController.h"
 
-int SearchController::SEEMove(Move m) {
-    // evaluate the SEE of a move. we assume the move has already been made, and will me immediately unmade
-
-    // decode the move
-    short fromSq, toSq, promo, flag, fromPc, toPc;
-    decodeMove(m, fromSq, toSq, promo, flag, fromPc, toPc);
+/* Static exchange evaluation
+ * It gives the material won/ lost by a series of captures on one square, where each side always captures with the cheapest piece.
+ * We use the swap algorithm: rather than making the captures on the board, we remove attackers from an occupancy bitboard.
+ * When a slider or pawn is removed, any x-ray attackers behind it are discovered using the new occupancy.
+ * It ignores pins, and pawns promoting on the recapture.
+ * */
+inline void SEEMoveInfo(Move move, short &to, U64 &occupied, short &firstAttacker, int &captured, U64 &fromBB, short side, U64 occupiedSquares) {
+    // works out the initial state of the exchange for a move
+    short from, promo, flag, fromType, toType;
+    from = move & fromMask;
+    to = (move & toMask) >> 6;
+    promo = (move & promoMask) >> 12;
+    flag = (move & flagMask) >> 14;
+    fromType = (move & fromTypeMask) >> 16;
+    toType = (move & toTypeMask) >> 19;
+
+    fromBB = toBB(from);
+    occupied = occupiedSquares;
+    firstAttacker = fromType;
+    captured = (toType == EMPTY) ? 0 : PieceScores[toType];
+
+    if (flag == PROMOTION) {
+        // the pawn becomes the promoted piece
+        firstAttacker = getPromoPiece(promo);
+        captured += PieceScores[firstAttacker] - PieceScores[PAWN];
+    } else if (flag == ENPASSANT) {
+        // the taken pawn isn't on the to square
+        occupied ^= toBB(side == WHITE ? to + 8 : to - 8);
+    }
+}
+int SearchController::SEE(Move move) {
+    /* Returns the value of the exchange started by move, for the side making it. The board isn't changed. */
+    if ((move & flagMask) >> 14 == CASTLING) return 0;
+
+    short to, attacker;
+    U64 occupied, fromBB;
+    int gain[32];
+    SEEMoveInfo(move, to, occupied, attacker, gain[0], fromBB, currentSide, occupiedSquares);
+
+    U64 attackers = getAttackersTo(to, occupied);
+    short side = currentSide;
+    int d = 0;
+    while (true) {
+        d ++;
+        gain[d] = PieceScores[attacker] - gain[d - 1]; // what we'd get if the piece that just captured is taken
+        if (std::max(-gain[d - 1], gain[d]) < 0) break; // neither side would want to carry on
+
+        // take the attacker off the board, and look for x-rays behind it
+        occupied ^= fromBB;
+        if (attacker != KNIGHT && attacker != KING) attackers |= getSliderAttackersTo(to, occupied);
+        attackers &= occupied;
+
+        // find the other side's cheapest attacker
+        side = !side;
+        U64 sideAttackers = attackers & pieceBB[side == WHITE ? nWhite : nBlack];
+        if (!sideAttackers) break;
+
+        attacker = getLeastValuableAttacker(sideAttackers, fromBB);
+
+        // the king can't capture if the square is still defended
+        if ((attacker == KING) && (attackers & pieceBB[side == WHITE ? nBlack : nWhite])) break;
+    }
 
-    int SEEEval = PieceScores[toPc] - SEE(toSq);
+    // go back through the swap list. at each point a side can choose to stop capturing
+    while (--d) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    }
 
-    return SEEEval;
+    return gain[0];
 }
-int SearchController::SEE(short square) {
-    /* Static exchange evaluation
-     * It returns the value of all the captures on one square.
-     * We always capture with the cheapest piece first.
-     * */
-    int SEEValue = 0;
+bool SearchController::SEEGreaterOrEqual(Move move, int threshold) {
+    /* Returns whether SEE(move) >= threshold. This can usually stop early, so it's cheaper than working out the full SEE. */
+    if ((move & flagMask) >> 14 == CASTLING) return 0 >= threshold;
+
+    short to, attacker;
+    U64 occupied, fromBB;
+    int captured;
+    SEEMoveInfo(move, to, occupied, attacker, captured, fromBB, currentSide, occupiedSquares);
+
+    // swap is how far we are above the threshold, from the point of view of the side to move in the exchange
+    int swap = captured - threshold;
+    if (swap < 0) return false; // even if we aren't recaptured, we don't make the threshold
+
+    swap = PieceScores[attacker] - swap;
+    if (swap <= 0) return true; // even if we lose the capturing piece, we make the threshold
+
+    occupied ^= fromBB;
+    U64 attackers = getAttackersTo(to, occupied) & occupied;
+    short side = currentSide;
+    bool result = true; // whether the side that made the move makes the threshold, if the exchange stopped now
+    while (true) {
+        side = !side;
+        attackers &= occupied;
+        U64 sideAttackers = attackers & pieceBB[side == WHITE ? nWhite : nBlack];
+        if (!sideAttackers) break;
+
+        result = !result;
+        attacker = getLeastValuableAttacker(sideAttackers, fromBB);
+
+        if (attacker == KING) {
+            // the king can only capture if the square isn't defended, in which case the exchange ends here
+            return (attackers & pieceBB[side == WHITE ? nBlack : nWhite]) ? !result : result;
+        }
 
-    // get the smallest attacker on the square (this actually doesn't include en-passants (or promotions). honestly I can't be asked)
-    short smallestAttackerSquare;
-    short smallestAttacker = -1;
-    getSmallestAttacker(square, smallestAttackerSquare, smallestAttacker);
+        swap = PieceScores[attacker] - swap;
+        if (swap < result) break;
 
-    // get the enemy piece
-    U64 to = toBB(square);
-    short toPiece = getPieceAt(to);
+        occupied ^= fromBB;
+        if (attacker != KNIGHT && attacker != KING) attackers |= getSliderAttackersTo(to, occupied);
+    }
 
-    // if there are no more attackers, return 0
-    if (smallestAttackerSquare != -1) {
-        /* Manually do the move */
-        setSquare(smallestAttacker, currentSide, square); // move the taking piece
-        setSquare(smallestAttacker, currentSide, smallestAttackerSquare); // move the taking piece
-        setSquare(toPiece, otherSide, square); // remove the taken piece
-        switchSide();
+    return result;
+}
+inline void SearchController::updatePV(int ply, Move move) {
+    // move has raised alpha at ply, so the PV from here is move, followed by the PV from the next ply
+    PVTable[ply][0] = move;
+    for (int i = 0; i < PVLength[ply + 1]; i ++) {
+        PVTable[ply][i + 1] = PVTable[ply + 1][i];
+    }
+    PVLength[ply] = PVLength[ply + 1] + 1;
+}
+void SearchController::getPV(MoveList &PV) {
+    // the PV from the root, first move first
+    PV.assign(PVTable[0], PVTable[0] + PVLength[0]);
+}
 
-        SEEValue = PieceWorths[toPiece] - SEE(square);
+void SearchController::setSearchLimits(SearchLimits &limits) {
+    // set the limits for the next search, and work out how long we have
+    searchLimits = limits;
+    timeManager.init(searchLimits, currentSide, *searchParameters);
+    wasPondering = searchSignals->ponder;
+}
+void SearchController::checkPonderhit() {
+    // when we stop pondering, the clock starts running for us, so restart the timer
+    if (wasPondering && !searchSignals->ponder) {
+        wasPondering = false;
+        timeManager.restart();
+    }
+}
+/* Move ordering
+ * The earlier we search the best move, the earlier we get a cut-off. So we score every move, and pick them best first.
+ * We remember quiet moves that cause cut-offs in three ways:
+    * Killer moves - two per ply. A quiet move that caused a cut-off in a sibling node is likely to work here too.
+    * History - a score for every [side][from][to], raised for moves that cause cut-offs and lowered for moves that don't.
+    * Counter moves - the move that refuted the opponent's previous move, indexed by [side][from][to] of that move.
+ * */
+inline int MVVLVA(Move move) {
+    // MVV-LVA: take the most valuable victim with the least valuable attacker
+    short fromType = (move & fromTypeMask) >> 16, toType = getTooPiece(move);
+    int victim = (toType == EMPTY) ? 0 : PieceScores[toType]; // promotions can be to an empty square
+    if ((move & flagMask) >> 14 == PROMOTION) victim += PieceScores[getPromoPiece((move & promoMask) >> 12)];
+    return victim * 10 - PieceScores[fromType] / 10;
+}
+void SearchController::scoreMoves(MoveList &moves, int *scores, Move TTMove, Move previousMove) {
+    Move *killers = stack[moveNumber].killers;
+    Move counterMove = 0;
+    if (previousMove && searchParameters->useCounterMoves) {
+        counterMove = counterMoves[otherSide][previousMove & fromMask][(previousMove & toMask) >> 6];
+    }
 
-        /* Manually do the move */
-        switchSide();
-        setSquare(smallestAttacker, currentSide, square); // move the taking piece
-        setSquare(smallestAttacker, currentSide, smallestAttackerSquare); // move the taking piece
-        setSquare(toPiece, otherSide, square); // remove the taken piece
+    for (size_t i = 0; i < moves.size(); i ++) {
+        Move move = moves[i];
+
+        if (move == TTMove) {
+            scores[i] = TT_MOVE_SCORE;
+        } else if (isCapture(move)) {
+            scores[i] = CAPTURE_SCORE + MVVLVA(move);
+        } else if (searchParameters->useKillers && move == killers[0]) {
+            scores[i] = KILLER_SCORE;
+        } else if (searchParameters->useKillers && move == killers[1]) {
+            scores[i] = KILLER_SCORE - 1;
+        } else if (move == counterMove) {
+            scores[i] = COUNTER_MOVE_SCORE;
+        } else {
+            scores[i] = searchParameters->useHistory ? historyTable[currentSide][move & fromMask][(move & toMask) >> 6] : 0;
+        }
+    }
+}
+void SearchController::scoreQuiescenceMoves(MoveList &moves, int *scores, Move TTMove) {
+    // captures are ordered by MVV-LVA, with captures that lose material (by SEE) put after everything else.
+    // the other quiescence moves (checks) go between the two
+    for (size_t i = 0; i < moves.size(); i ++) {
+        Move move = moves[i];
+
+        if (move == TTMove) {
+            scores[i] = TT_MOVE_SCORE;
+        } else if (isCapture(move)) {
+            // we only need SEE if the attacker is worth more than the victim, as otherwise we can't lose material
+            short fromType = (move & fromTypeMask) >> 16, toType = getTooPiece(move);
+            bool winning = ((toType != EMPTY) && (PieceScores[toType] >= PieceScores[fromType])) || SEEGreaterOrEqual(move, 0);
+            scores[i] = (winning ? CAPTURE_SCORE : LOSING_CAPTURE_SCORE) + MVVLVA(move);
+        } else {
+            scores[i] = 0;
+        }
+    }
+}
+inline void SearchController::pickMove(MoveList &moves, int *scores, size_t index) {
+    // swap the best scoring move left in the list into index. this is a selection sort done one step at a time,
+    // which is cheaper than sorting, as we often get a cut-off after a few moves
+    size_t best = index;
+    for (size_t i = index + 1; i < moves.size(); i ++) {
+        if (scores[i] > scores[best]) best = i;
     }
 
-    return SEEValue;
+    std::swap(moves[index], moves[best]);
+    std::swap(scores[index], scores[best]);
 }
-void SearchController::extractPV(MoveList &moves) {
-    /* Extract the principle variation from the TT */
+inline void SearchController::updateHistory(Move move, int bonus) {
+    // the 'gravity' update keeps the history score in [-maxHistory, maxHistory]. large scores move less
+    int &entry = historyTable[currentSide][move & fromMask][(move & toMask) >> 6];
+    entry += bonus - entry * abs(bonus) / searchParameters->maxHistory;
+}
+void SearchController::updateQuietHistory(Move move, Move *quietsSearched, int numQuietsSearched, int depth, Move previousMove) {
+    // move is a quiet move that just caused a cut-off. quietsSearched are the quiet moves searched before it that didn't
+    Move *killers = stack[moveNumber].killers;
+    if (searchParameters->useKillers && killers[0] != move) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
 
-    // generate legal moves
-    genMoves();
-    MoveList legalMoves = combinedMoveList;
-    if (inCheckMate() | inStalemate() | checkThreefold()) {
-        // check if the game is over
-        return;
+    if (searchParameters->useHistory) {
+        int bonus = std::min(depth * depth, searchParameters->maxHistory);
+        updateHistory(move, bonus);
+        for (int i = 0; i < numQuietsSearched; i ++) {
+            updateHistory(quietsSearched[i], -bonus);
+        }
     }
 
-    // probe the TT
-    bool found = false;
-    TTNode *ttEntry = TT->probe(zobristState, found);
-    auto pos = std::find(legalMoves.begin(), legalMoves.end(), ttEntry->move);
+    if (previousMove && searchParameters->useCounterMoves) {
+        counterMoves[otherSide][previousMove & fromMask][(previousMove & toMask) >> 6] = move;
+    }
+}
+void SearchController::newSearch() {
+    // get the move ordering tables ready for a new search. the killers are specific to the old position, but the history is still useful
+    rootMoveNumber = moveNumber;
+    searchAborted = false;
+    rootMoves.clear();
+
+    for (int i = moveNumber; i < std::min(moveNumber + MAX_PLY + 1, MAX_GAME_LENGTH); i ++) {
+        stack[i].killers[0] = stack[i].killers[1] = 0;
+        stack[i].excludedMove = 0;
+    }
+    for (int side = 0; side < 2; side ++) {
+        for (int from = 0; from < 64; from ++) {
+            for (int to = 0; to < 64; to ++) {
+                historyTable[side][from][to] /= 2;
+            }
+        }
+    }
+}
+inline bool SearchController::isCapture(Move move) {
+    // captures and promotions. castling is encoded as a capture of our own rook, so isn't counted
+    short flag = (move & flagMask) >> 14;
+    if (flag == CASTLING) return false;
 
-    // check the move is legal, and the TT entry is found
-    if (found && (pos != legalMoves.end())) {
-        moves.insert(moves.begin(), ttEntry->move);
-        makeMove(ttEntry->move);
-        extractPV(moves);
-        unMakeMove();
-    } else {
-        return;
+    return (getTooPiece(move) != EMPTY) || (flag == PROMOTION);
+}
+inline bool SearchController::checkStop() {
+    /* See whether we've been told to stop, or we've hit a limit.
+     * We only check every few nodes as it's an atomic read (and the timer isn't free either).
+     * The time/ node limits don't count while we're pondering.
+     * */
+    if ((searchStats.totalNodesSearched & (searchParameters->nodesBetweenStopChecks - 1)) == 0) {
+        checkPonderhit();
+
+        if (searchSignals->stop) {
+            searchAborted = true;
+        } else if (!wasPondering) {
+            if (timeManager.outOfTime() ||
+                (searchLimits.nodes && (searchStats.totalNodesSearched >= searchLimits.nodes))) {
+                searchAborted = true;
+            }
+        }
     }
-};
+
+    return searchAborted;
+}
 
 int SearchController::quiescence(int alpha, int beta, int depth) {
     /* What is the Quiescence Search?
@@ -97,6 +302,9 @@ int SearchController::quiescence(int alpha, int beta, int depth) {
      * */
     searchStats.totalNodesSearched++; // count the number of nodes searched
     searchStats.totalQuiescenceSearched ++; // count the quiescence nodes searched
+    if (checkStop()) return 0; // the result is thrown away, so it doesn't matter what we return
+    PVLength[getPly()] = 0; // we don't keep the PV through the quiescence search
+    if (moveNumber >= MAX_GAME_LENGTH - 1) return evaluate(); // the stack is full, so we can't make any more moves
 
     int originalAlpha = alpha, originalBeta = beta; // store the original alpha/ beta so we can identify this node type
 
@@ -120,84 +328,84 @@ int SearchController::quiescence(int alpha, int beta, int depth) {
     // * 2.
     //TODO. side effects! implicit data dependence
     getMoveList(); // annoyingly we have to generate all moves before checking for checkmate/ stalemate
+    bool nodeInCheck = inCheck; // inCheck is overwritten when we search deeper, so keep our own copy
     if (inCheckMate()) {
         // return static evaluation ~ do this after checking if depth == 0, to avoid generating moves
-        // return -MATE as a checkmate is very bad for the current player
-        return (-MATE - depth);
-    } else if (inStalemate() | checkThreefold()) {
-        // if there is a three-fold or a inStalemate, return the negative of the evaluation
+        // return a mate score as a checkmate is very bad for the current player. the sooner the mate, the worse
+        return matedIn(getPly());
+    } else if (inStalemate()) {
         return searchParameters->stalemateEvaluation;
+    } else if (isDraw()) {
+        // a repetition or the fifty move rule
+        return searchParameters->drawEvaluation;
     }
 
     // * 3. Probe the TT
     TTNode *node;
-    MoveList moves = activeMoveList;
-    //TODO get move from hash table if exists
+    MoveList &moves = stack[moveNumber].qMoves;
+    moves = activeMoveList; // this keeps the slot's capacity, so it doesn't allocate
+    Move TTMove = 0;
     if (searchParameters->ttParameters.useTTInQSearch) {
         bool nodeExists = false; // whether we've stored a search for this position
         node = TT->probe(zobristState, nodeExists); // probe the table
 
         if (nodeExists) {
-            // see if the node exists and put it to the front of the move list
-            Move TTMove = node->move;
-            auto pos = std::remove(moves.begin(), moves.end(), TTMove);
+            TTMove = node->move;
             TT->totalTTMovesFound ++;
 
             // see if the move is actually valid
-            if (pos != moves.end()) {
+            if (std::find(moves.begin(), moves.end(), TTMove) != moves.end()) {
                 TT->totalTTMovesInMoveList ++;
-                moves.insert(moves.begin(), TTMove);
+            } else {
+                TTMove = 0;
             }
         }
     }
 
     // * 4.
+    // score the moves before making any of them, so the best capture is searched first, and losing captures can be pruned without being made
+    int moveScores[MAX_MOVES];
+    scoreQuiescenceMoves(moves, moveScores, TTMove);
+
     int nodeEvaluation = -INFIN;
     int movesSearched = 0; // keep track of the number of moves properly searched, as if none we will need to do a proper evaluation
-    for (Move move: moves) {
-        if (!(move & toTypeMask)) {
+    for (size_t i = 0; i < moves.size(); i ++) {
+        pickMove(moves, moveScores, i);
+        Move move = moves[i];
+
+        if (!isCapture(move)) {
             // see if this is a non-capture quiescence move
             searchStats.totalNonCaptureQSearched ++;
 
-            // if we are deep enough stop making these moves, unless promotion
-            if ((depth <= searchParameters->maxDepthForChecks) && !(move & promoMask)) {
+            // if we are deep enough stop making these moves
+            if (depth <= searchParameters->maxDepthForChecks) {
                 continue;
             }
         }
 
-        makeMove(move); // make the move before doing SEE
-
         /* a. SSE pruning/ Delta pruning
          * As a quiescence search should improve the nodes' evaluation, we can confidently prune nodes with negative SEE.
+         * The moves are sorted, so once we reach the losing captures, every move left is a losing capture.
          * We use this together with delta pruning, where we prune a move if we don't believe it can raise alpha
          * i.e. lazyEval() + SEE + Margin < alpha.
+         * Both are done before making the move.
          * */
-        int SEEEvaluation = SEEMove(moveHistory.back());
-        if (searchParameters->useSEE) {
-
-            if (
-                    SEEEvaluation < 0 ||
-                    (searchParameters->useDelta &&
-                     (standPat + PieceScores[getTooPiece(move)] + searchParameters->deltaMargin < alpha))
-                    ) {
-                unMakeMove();
-                continue;
-            }
-        } else {
-            if (    false ||
-                    (searchParameters->useDelta &&
-                     (standPat + PieceScores[getTooPiece(move)] + searchParameters->deltaMargin < alpha))
-                    ) {
-                unMakeMove();
-                continue;
-            }
+        if (searchParameters->useSEE && moveScores[i] < 0) {
+            break;
         }
+        if (searchParameters->useDelta &&
+            (standPat + PieceScores[getTooPiece(move)] + searchParameters->deltaMargin < alpha)) {
+            continue;
+        }
+
+        makeMove(move);
 
         movesSearched ++;
 
         // do a full depth search
         int subEval = -quiescence(-beta, -alpha, depth - 1);
         unMakeMove(); // unmake the move
+        if (searchAborted) return 0;
 
         if (subEval > nodeEvaluation) {
             nodeEvaluation = subEval;
@@ -222,27 +430,39 @@ int SearchController::quiescence(int alpha, int beta, int depth) {
     // * 6. write to the TT
     int evaluationType = getEvaluationType(nodeEvaluation, originalAlpha, beta);
     if (searchParameters->ttParameters.useTTInQSearch) {
-        TT->set(zobristState, bestMove, depth, evaluationType, moveNumber, nodeEvaluation);
+        int TTEval = scoreToTT(nodeEvaluation, getPly());
+        int TTDepth = 0; // the depth is negative here, and it's stored unsigned, so the entry is stored as shallower than any real search
+        TT->set(zobristState, bestMove, TTDepth, evaluationType, TTEval, nodeInCheck ? NO_STATIC_EVAL : standPat);
     }
 
     return nodeEvaluation;
 }
-int SearchController::negaMax(int alpha, int beta, int depth, Move &bestMove) {
+int SearchController::negaMax(int alpha, int beta, int depth, Move &bestMove, bool allowNullMove) {
     /* Negamax */
     /* How does it work?
      * 1. The depth counts down to 0. At which point we enter the quiescence search
+     * 1b. Mate distance pruning.
      * 2. We then generate moves, so we can check for checkmates/stalemates/three-folds. It returns a massive negative number in the case of check-mate (as it would be bad for the current player).
      * 3. Probe the TT
-     * 4. Loop through all moves, execute negamax. If a move is better than our best search so far, save it as the best move. I use alpha beta pruning
-         * a. Try a late move reduction. This is where we reduced the depth of the search. We only do it under certain circumstances.
-         * b. Beta represent-> the maximum score that the minimising player is assured of. So if the evaluation is greater than beta, the minimising player won't take this path.
-         * c. Alpha represents the minimum score that the maximising player is assured of. So if the evaluation is greater than alpha, this becomes new alpha!
+     * 3a. Probe the tablebases. Then internal iterative reduction. Then static evaluation pruning: reverse futility pruning and razoring.
+     * 3b. Try null move pruning.
+     * 3c. Singular extensions/ multi-cut.
+     * 4. Order the moves: TT move, captures (MVV-LVA), killers, the counter move, then the rest of the quiet moves by history.
+     *    Loop through all moves, execute negamax. If a move is better than our best search so far, save it as the best move. I use alpha beta pruning
+         * a. Futility pruning of quiet moves. Then try a late move reduction, or extend the search if the move gives check. This is where we reduce the depth of the search for quiet moves late in the move list.
+         * b. Principal variation search. Every move after the first is searched with a null window first, and only re-searched if it beats alpha.
+         * c. Beta represent-> the maximum score that the minimising player is assured of. So if the evaluation is greater than beta, the minimising player won't take this path.
+         * d. Alpha represents the minimum score that the maximising player is assured of. So if the evaluation is greater than alpha, this becomes new alpha! The move then heads the principal variation from this ply.
      * 5. Work out the alpha/beta evaluation type. Either we have hard failed high, in which case the evaluation is a lower bound - beta. Or we have failed low, so the evaluation is an upper bound - alpha. Then write to TT
      * 6. Return the score from the best move searched.
      * */
     searchStats.totalNodesSearched++; // count the number of nodes searched
+    if (checkStop()) return 0; // the result is thrown away, so it doesn't matter what we return
     int originalAlpha = alpha, originalBeta = beta; // store the original alpha/ beta so we can identify this node type
     int nodeEvaluation = -INFIN;
+    int ply = getPly();
+    PVLength[ply] = 0; // if we don't raise alpha, there's no PV from this node
+    if (moveNumber >= MAX_GAME_LENGTH - 1) return evaluate(); // the stack is full, so we can't make any more moves
 
     // * 1.
     if (depth <= 0) {
@@ -251,46 +471,71 @@ int SearchController::negaMax(int alpha, int beta, int depth, Move &bestMove) {
         else {return evaluate();}
     }
 
+    // * 1b. Mate distance pruning
+    // Even if we mate on the next move, we can't score more than mateIn(ply + 1). And we can't do worse than being mated now.
+    // If a quicker mate has already been found elsewhere in the tree, the window is empty and there's nothing to search.
+    if (searchParameters->useMateDistancePruning && ply > 0) {
+        alpha = std::max(alpha, matedIn(ply));
+        beta = std::min(beta, mateIn(ply + 1));
+        if (alpha >= beta) return alpha;
+    }
+
     // * 2.
-    MoveList moves = getMoveList(); // generate moves before checking for checkmate/ stalemate
+    genMoves(); // generate moves before checking for checkmate/ stalemate
+    MoveList &moves = stack[moveNumber].moves;
+    moves = combinedMoveList; // this keeps the slot's capacity, so it doesn't allocate
+    if ((ply == 0) && !rootMoves.empty()) moves = rootMoves;
+    bool nodeInCheck = inCheck; // inCheck is overwritten when we search deeper, so keep our own copy
     if (inCheckMate()) {
         // return static evaluation ~ do this after checking if depth == 0, to avoid generating moves
-        // return -MATE as a checkmate is very bad for the current player
-        return (-MATE - depth);
-    } else if (inStalemate() | checkThreefold()) {
-        // if there is a three-fold or a inStalemate, return the negative of the evaluation
+        // return a mate score as a checkmate is very bad for the current player. the sooner the mate, the worse
+        return matedIn(ply);
+    } else if (inStalemate()) {
         return searchParameters->stalemateEvaluation;
+    } else if ((ply > 0) && isDraw()) {
+        // a repetition or the fifty move rule. at the root we still need a move
+        return searchParameters->drawEvaluation;
     }
 
     // * 3. Probe the TT
+    // In a singular extension search we leave out a move, so the TT entry (which includes that move) can't be used to cut off.
+    // Nor can it in PV nodes (which includes the root), as a cut off there would cut the PV short.
+    bool PVNode = (beta - alpha) > 1;
+    Move excludedMove = stack[moveNumber].excludedMove;
     TTNode *node;
+    Move TTMove = 0; // the best move stored in the TT (if it's legal). it's searched first
+    int TTEval = 0, TTDepth = -1, TTFlag = -1; // copied, as the entry can be overwritten by searches below this node
+    int TTStaticEval = NO_STATIC_EVAL;
     if (searchParameters->ttParameters.useTT) {
         bool nodeExists = false; // whether we've stored a search for this position
         node = TT->probe(zobristState, nodeExists); // probe the table
 
         if (nodeExists) {
-            // see if the node exists and put it to the front of the move list
-            Move TTMove = node->move;
-            auto pos = std::remove(moves.begin(), moves.end(), TTMove);
+            // see if the node exists
             TT->totalTTMovesFound ++;
 
             // see if the move is actually valid
-            if (pos != moves.end()) {
+            if (std::find(moves.begin(), moves.end(), node->move) != moves.end()) {
+                TTMove = node->move;
+                TTEval = scoreFromTT(node->eval, ply);
+                TTDepth = node->depth;
+                TTFlag = node->flag;
+                TTStaticEval = node->staticEval;
                 TT->totalTTMovesInMoveList ++;
-                moves.insert(moves.begin(), TTMove);
 
                 // try using the results to improve alpha/ beta
-                if ((node->depth >= depth) && searchParameters->ttParameters.useTTPruning) {
+                if ((node->depth >= depth) && searchParameters->ttParameters.useTTPruning && !excludedMove && !PVNode) {
                     if (node->flag == EXACT_EVAL) {
                         bestMove = TTMove;
-                        return node->eval;
+                        return TTEval;
                     } else if (node->flag == LOWER_EVAL) {
-                        alpha = alpha > node->eval ? alpha: node->eval;
+                        alpha = alpha > TTEval ? alpha: TTEval;
                     } else if (node->flag == UPPER_EVAL) {
-                        beta = beta < node->eval ? beta: node->eval;
+                        beta = beta < TTEval ? beta: TTEval;
                     }
 
                     if (alpha >= beta) {
+                        bestMove = TTMove;
                         return alpha;
                     }
                 }
@@ -298,50 +543,246 @@ int SearchController::negaMax(int alpha, int beta, int depth, Move &bestMove) {
         }
     }
 
+    // * 3a. Tablebases
+    /* With few enough pieces, the tablebases know the result. We only probe straight after a capture or pawn move,
+     * as that's when the material changes (and the tables don't know about the fifty move counter).
+     * A win or loss is scored below mate, and by ply, so the quickest win is preferred. If the result is a bound that doesn't cut off, we carry on searching.
+     * */
+    int numPieces = count(occupiedSquares);
+    if (searchParameters->useTablebases && TBLargest && (ply > 0) && !excludedMove &&
+        (halfMoveClock == 0) && !CastleRights && (numPieces <= TBLargest) &&
+        ((numPieces < TBLargest) || (depth >= searchParameters->syzygyProbeDepth))) {
+
+        TBProbeState result;
+        int wdl = probeWDL(result);
+
+        if (result != TB_FAIL) {
+            searchStats.totalTBHits ++;
+
+            int drawScore = searchParameters->syzygy50MoveRule ? 1 : 0; // with the fifty move rule, cursed wins and blessed losses are draws
+            int TBEval = (wdl < -drawScore) ? tbLossIn(ply) :
+                         (wdl > drawScore) ? tbWinIn(ply) : searchParameters->drawEvaluation + 2 * wdl * drawScore;
+            int TBBound = (wdl < -drawScore) ? UPPER_EVAL : ((wdl > drawScore) ? LOWER_EVAL : EXACT_EVAL);
+
+            if ((TBBound == EXACT_EVAL) || ((TBBound == LOWER_EVAL) ? (TBEval >= beta) : (TBEval <= alpha))) {
+                return TBEval;
+            }
+        }
+    }
+
+    // Internal iterative reduction
+    /* Without a TT move we're searching with poor move ordering, so the node is expensive and the result is less reliable.
+     * Rather than a separate shallow search to find a good first move (internal iterative deepening), we just search this node a ply shallower.
+     * The best move found is stored in the TT, so when the next iteration reaches this node it has a TT move.
+     * */
+    if (searchParameters->useIIR && !TTMove && (depth >= searchParameters->IIRMinDepth)) {
+        depth --;
+    }
+
+    // Static evaluation pruning
+    /* Near the leaves, the static evaluation is a good guess of the search result. It's cheap, as the material evaluation is kept incrementally.
+        * Reverse futility pruning: if the static evaluation beats beta by a margin that grows with depth, we assume the search would too.
+        * Razoring: if the static evaluation is so far below alpha that no quiet move could help, we check with a quiescence search.
+            * If that fails low too, we trust it.
+        * Futility pruning (in the move loop): quiet moves are skipped if the static evaluation plus a margin can't raise alpha.
+     * None of these are safe in check (the static evaluation means nothing), in PV nodes, or around mate scores.
+     * */
+    int staticEval = nodeInCheck ? -INFIN : (TTStaticEval != NO_STATIC_EVAL) ? TTStaticEval : relativeLazy(); // the TT saves us evaluating again
+    stack[moveNumber].staticEval = staticEval;
+    bool canPruneStatically = !PVNode && !nodeInCheck && !excludedMove;
+
+    if (searchParameters->useReverseFutility && canPruneStatically &&
+        (depth <= searchParameters->reverseFutilityMaxDepth) && (abs(beta) < TB_WIN_IN_MAX_PLY) &&
+        (staticEval - searchParameters->reverseFutilityMargin * depth >= beta)) {
+        return staticEval;
+    }
+
+    if (searchParameters->useRazoring && canPruneStatically &&
+        (depth <= searchParameters->razoringMaxDepth) && (abs(alpha) < TB_WIN_IN_MAX_PLY) &&
+        (staticEval + searchParameters->razoringMargin * depth < alpha)) {
+        int razorEval = quiescence(alpha, beta, 0);
+        if (searchAborted) return 0;
+        if (razorEval < alpha) {
+            return razorEval;
+        }
+    }
+
+    bool futile = searchParameters->useFutility && canPruneStatically &&
+                  (depth <= searchParameters->futilityMaxDepth) && (abs(alpha) < TB_WIN_IN_MAX_PLY) &&
+                  (staticEval + searchParameters->futilityBase + searchParameters->futilityMargin * depth <= alpha);
+
+    // * 3b. Null move pruning
+    /* If we can pass the turn, and the opponent still can't stop us failing high with a reduced search, then we assume a real move would fail high too.
+     * This isn't safe when:
+        * We are in check (passing would be illegal).
+        * We only have a king and pawns, as zugzwang is likely i.e. passing would actually be the best move.
+        * The last move was a null move, or this is a PV node.
+     * At high depth we verify the cut-off with a normal reduced search, to guard against zugzwang we didn't catch.
+     * */
+    if (searchParameters->useNullMove && allowNullMove && !PVNode && !nodeInCheck && !excludedMove &&
+        (depth >= searchParameters->nullMoveMinDepth) && (abs(beta) < TB_WIN_IN_MAX_PLY) &&
+        (pieceBB[friendly] & ~(pieceBB[PAWN] | pieceBB[KING])) &&
+        (staticEval >= beta)) {
+
+        int R = searchParameters->nullMoveReduction + depth / searchParameters->nullMoveDepthDivisor;
+        Move nullBestMove = 0;
+
+        makeNullMove();
+        int nullEval = -negaMax(-beta, -beta + 1, depth - 1 - R, nullBestMove, false);
+        unMakeNullMove();
+        if (searchAborted) return 0;
+
+        if (nullEval >= beta) {
+            // don't trust mate or tablebase scores from a null move search. passing resets the fifty move counter, so the child probes the tablebases
+            if (nullEval >= TB_WIN_IN_MAX_PLY) nullEval = beta;
+
+            if (depth < searchParameters->nullMoveVerifyDepth) {
+                return nullEval;
+            }
+
+            // verification search
+            int verifyEval = negaMax(beta - 1, beta, depth - R, nullBestMove, false);
+            if (searchAborted) return 0;
+            if (verifyEval >= beta) {
+                return nullEval;
+            }
+        }
+    }
+
+    // * 3c. Singular extensions
+    /* If the TT says its move beats beta, we check whether it's the only good move.
+     * We search every other move at reduced depth, against a bound a little below the TT evaluation.
+     * If they all fail low, the TT move is 'singular': the position depends on it, so it gets extended.
+     * If they fail high against a bound that also beats beta, then several moves beat beta, and we can cut off (multi-cut).
+     * */
+    bool singular = false;
+    if (searchParameters->useSingularExtensions && (ply > 0) && TTMove && !excludedMove &&
+        (depth >= searchParameters->singularMinDepth) &&
+        (TTDepth >= depth - searchParameters->singularTTDepthMargin) &&
+        (TTFlag != UPPER_EVAL) && !isMateScore(TTEval)) {
+
+        int singularBeta = TTEval - searchParameters->singularMargin * depth;
+        int singularDepth = (depth - 1) / 2;
+        Move singularBestMove = 0;
+
+        stack[moveNumber].excludedMove = TTMove;
+        int singularEval = negaMax(singularBeta - 1, singularBeta, singularDepth, singularBestMove, false);
+        stack[moveNumber].excludedMove = 0;
+        PVLength[ply] = 0; // the singular search was at this ply too, so clear the PV it left
+        if (searchAborted) return 0;
+
+        if (singularEval < singularBeta) {
+            singular = true;
+        } else if (searchParameters->useMultiCut && (singularBeta >= beta)) {
+            return singularBeta;
+        }
+    }
+
     // * 4.
-    int posInMoveList = 0; // how far we are into the move-list
-    int fullMovesSearched = 0; // the number of full searches we have carried out
+    Move previousMove = lastMove();
+    int moveScores[MAX_MOVES];
+    scoreMoves(moves, moveScores, TTMove, previousMove);
+
+    Move quietsSearched[MAX_MOVES]; // the quiet moves that didn't cause a cut-off. their history is lowered
+    int numQuietsSearched = 0;
+
+    int fullMovesSearched = 0; // the number of moves we have searched
     Move subBestMove = 0;
-    for (Move move: moves) {
-        posInMoveList ++;
+    for (size_t i = 0; i < moves.size(); i ++) {
+        pickMove(moves, moveScores, i);
+        Move move = moves[i];
+        if (move == excludedMove) continue;
+        bool quiet = !isCapture(move);
+        bool checking = givesCheck(move);
+        bool killer = (move == stack[moveNumber].killers[0]) || (move == stack[moveNumber].killers[1]);
+
+        // a. Futility pruning
+        // We always search at least one move, and never prune the TT move or moves that give check.
+        if (futile && (fullMovesSearched > 0) && quiet && (move != TTMove) && !checking) {
+            continue;
+        }
 
-        // a. Late move reduction (Doesn't work at the moment)!
-        int subEval;
+        // Late move reduction
+        // With good move ordering, moves late in the list are very unlikely to be best. So we search quiet moves late in the list at a reduced depth.
+        // If one surprises us and beats alpha, it's searched again at full depth.
+        // We don't reduce tactical moves (captures, promotions, checks), in check, or in PV nodes.
+        int reduction = 0;
         if (
                 (searchParameters->useLMR) && // LMR is available
                 (fullMovesSearched >= searchParameters->minMovesBeforeLMR) &&  // we've searched some moves to full depth
-                (depth <= searchParameters->useLMRDepth) && // we are deep enough
-                (posInMoveList > activeMoveList.size()) && // move is not tactical
-                (!inCheck) // not in check
+                (depth >= searchParameters->LMRMinDepth) && // we have enough depth to reduce
+                (!PVNode) && // not a PV node
+                (!nodeInCheck) && // not in check
+                (!killer) && // killer moves are likely to be good
+                quiet && !checking // move is not tactical
                 ) {
-            // do a search at a reduced depth to see if we fail low, if we do, then we prune this node
-            subEval = -negaMax(-alpha - 1, -alpha, depth - 2, subBestMove);
-            if (subEval <= alpha) {
-                continue;
-            }
-        } 
+            reduction = LMRReductions[std::min(depth, 63)][std::min(fullMovesSearched, 63)];
+            reduction = std::min(reduction, depth - 2); // always leave at least one ply before the quiescence search
+        }
+
+        // Extensions
+        // A check forces a reply, so it's cheap to search one ply deeper, and it stops mating attacks falling over the horizon.
+        // A singular TT move is also searched one ply deeper (see 3c).
+        // We stop extending deep in the tree, so a series of checks can't explode the search.
+        int extension = 0;
+        if (ply < MAX_PLY / 2) {
+            if (searchParameters->useCheckExtensions && checking) extension = 1;
+            if (singular && (move == TTMove)) extension = 1;
+        }
+        int newDepth = depth - 1 + extension;
 
         fullMovesSearched ++;
 
-        // do a full depth search
+        // b. Principal variation search
+        // We expect the first move to be the best, so we search it with the full window.
+        // The rest of the moves we just try to prove are worse than alpha, with a (much cheaper) null window search.
+        // If one of them turns out to be better, we have to search it again with the full window.
+        // Without PVS, the later moves are still reduced, and searched again at full depth if they beat alpha.
+        int subEval;
         makeMove(move); // make the move
-        subEval = -negaMax(-beta, -alpha, depth - 1, subBestMove);
+        if (fullMovesSearched == 1) {
+            subEval = -negaMax(-beta, -alpha, newDepth, subBestMove);
+        } else if (searchParameters->usePVS) {
+            subEval = -negaMax(-alpha - 1, -alpha, newDepth - reduction, subBestMove);
+            if ((reduction > 0) && (subEval > alpha)) {
+                subEval = -negaMax(-alpha - 1, -alpha, newDepth, subBestMove);
+            }
+            if ((subEval > alpha) && (subEval < beta)) {
+                subEval = -negaMax(-beta, -alpha, newDepth, subBestMove);
+            }
+        } else {
+            subEval = -negaMax(-beta, -alpha, newDepth - reduction, subBestMove);
+            if ((reduction > 0) && (subEval > alpha)) {
+                subEval = -negaMax(-beta, -alpha, newDepth, subBestMove);
+            }
+        }
         unMakeMove(); // unmake the move
 
-        // b. Fail low
+        // if we've been stopped, the sub-search is garbage. bestMove holds the best move fully searched so far
+        if (searchAborted) return 0;
+
+        // c. Fail low
         if (subEval > nodeEvaluation) {
             nodeEvaluation = subEval;
             bestMove = move; // (this used to be in the following if statement and that caused a bug!)
             if (nodeEvaluation > alpha) {
                 alpha = nodeEvaluation;
+                updatePV(ply, move);
             }
         }
 
-        // c. Fail hard beta cut off.
+        // d. Fail hard beta cut off.
         if (alpha >= beta) {
+            // remember the quiet moves that cause cut-offs, to help move ordering
+            if (quiet) {
+                updateQuietHistory(move, quietsSearched, numQuietsSearched, depth, previousMove);
+            }
+
             alpha = beta;
             break;
         }
+
+        if (quiet) quietsSearched[numQuietsSearched ++] = move;
     }
 
     /* Discussion: How should we treat each evaluation type?
@@ -352,23 +793,29 @@ int SearchController::negaMax(int alpha, int beta, int depth, Move &bestMove) {
      * All in all, exact valuations are best
      * */
     // * 5. write to the TT
+    // a singular extension search leaves out a move, so its result isn't the real evaluation of this position
     int evaluationType = getEvaluationType(nodeEvaluation, originalAlpha,  beta); // we pass the original alpha, and the new beta
-    if (searchParameters->ttParameters.useTT) {
-        TT->set(zobristState, bestMove, depth, evaluationType, moveNumber, nodeEvaluation);
+    if (searchParameters->ttParameters.useTT && !excludedMove) {
+        int TTEval = scoreToTT(nodeEvaluation, ply);
+        TT->set(zobristState, bestMove, depth, evaluationType, TTEval, nodeInCheck ? NO_STATIC_EVAL : staticEval);
     }
 
     // * 6.
     return nodeEvaluation; // return the evaluation for the best move
 }
-SearchResults search(SearchController &SuperBoard) {
+SearchResults search(SearchController &SuperBoard, SearchLimits limits = SearchLimits()) {
     /* This is the search function. It executes a search, and returns the results */
     /* How does it do it?
-     * 0. Firstly prepare various variables for the search.
-     * 1 Check if the game has ended
-     * 2. Iterative deepening. The search is timed, and the searchDepth is increased by one until the search takes an appropriate amount of time.
-         * b. Run negamax
-         * c. Either exit out of iterative deepening depending on if the search took long enough, or increase the depth and keep going.
+     * 0. Firstly prepare various variables for the search, and work out how long we have.
+     * 1 Check if the game has ended. If the position is in the tablebases, only keep the root moves that hold the best result.
+     * 2. Iterative deepening. The searchDepth is increased by one until we run out of time (or hit a limit).
+         * b. Run negamax, inside an aspiration window.
+         * c. If we were told to stop (or ran out of time) part way through an iteration, we throw it away and use the last completed one.
+            * Otherwise read the PV, and report on the iteration.
          * d. See if we must break out of iterative deepening
+         * e. See if we have time for another iteration. We spend more time if the best move keeps changing, or the score drops,
+            * and less if the best move is stable.
+            * If we are pondering, we keep going until we get a ponderhit/ stop.
      * 3. Build the results object, and return it
      * */
 
@@ -377,49 +824,138 @@ SearchResults search(SearchController &SuperBoard) {
     SearchParameters *searchParameters = SuperBoard.getSearchParameters(); // fetch the search parameters
     SuperBoard.clearStats(); // clear the stats counter
     SuperBoard.getTT()->clearTotals(); // clear the totals from the transposition table //todo embed this into searchstates
+    SuperBoard.getTT()->newSearch(); // age the entries left over from previous searches
+    SuperBoard.newSearch();
+    SuperBoard.setSearchLimits(limits);
+    initLMRReductions(*searchParameters);
+    SearchSignals *searchSignals = SuperBoard.getSearchSignals();
+    TimeManager *timeManager = SuperBoard.getTimeManager();
 
     int eval = 0; // evaluation for this position
-    float searchTime = 0; // time taken for the search
     int searchDepth = searchParameters->startingDepth; // the depth at which we search
-    Move bestMove;
+    int completedDepth = 0; // the depth of the last completed iteration
+    Move bestMove = 0, iterationBestMove = 0;
+    MoveList PV; // the principal variation from the last completed iteration
+
+    int previousEval = 0; // the evaluation from the last iteration, relative to the current side
+    int stableIterations = 0; // how many iterations in a row the best move has stayed the same
 
     // * 1. Check if the game has ended
-    SuperBoard.getMoveList();
-    if (SuperBoard.inCheckMate() || SuperBoard.inStalemate() || SuperBoard.checkThreefold()) {
+    MoveList rootMoves = SuperBoard.getMoveList();
+    // a draw by repetition or the fifty move rule has to be claimed, so we still search for a move
+    if (SuperBoard.inCheckMate() || SuperBoard.inStalemate()) {
         searchResults.searchCompleted = false;
         return searchResults;
     }
 
-    // * 2. Iterative deepening
-    while (searchTime < searchParameters->minSearchTime) {
-        Timer timer; // start the timer
+    // if the position is in the tablebases, only search the moves that keep the best result
+    if (searchParameters->useTablebases && TBLargest && SuperBoard.probeRoot(rootMoves)) {
+        SuperBoard.setRootMoves(rootMoves);
+    }
 
+    // * 2. Iterative deepening
+    while (!limits.depth || (searchDepth <= limits.depth)) {
         // * b. Run negamax
-        eval = SuperBoard.negaMax(-INFIN, INFIN, searchDepth, bestMove);
+        // We use an aspiration window around the last iteration's score, as we expect the score not to change much.
+        // If we fall outside of it, we widen the window on that side (exponentially) and search again.
+        int alpha = -INFIN, beta = INFIN, window = searchParameters->aspirationWindow;
+        if (searchParameters->useAspirationWindows && (searchDepth >= searchParameters->aspirationStartDepth) && (abs(previousEval) < MATE)) {
+            alpha = previousEval - window;
+            beta = previousEval + window;
+        }
+
+        int iterationEval;
+        while (true) {
+            iterationEval = SuperBoard.negaMax(alpha, beta, searchDepth, iterationBestMove);
+            if (SuperBoard.wasAborted()) break;
+
+            if ((iterationEval <= alpha) && (alpha > -INFIN)) {
+                // fail low
+                window *= 2;
+                alpha = std::max(iterationEval - window, -INFIN);
+            } else if ((iterationEval >= beta) && (beta < INFIN)) {
+                // fail high
+                window *= 2;
+                beta = std::min(iterationEval + window, INFIN);
+            } else {
+                break;
+            }
 
+            // once the window is big enough, just search the whole thing
+            if (window > searchParameters->maxAspirationWindow) {
+                alpha = -INFIN;
+                beta = INFIN;
+            }
+        }
+
+        // * c. See if we were stopped part way through
+        if (SuperBoard.wasAborted()) {
+            // we can still trust the best move if it was fully searched, and we have nothing better
+            if (!bestMove) bestMove = iterationBestMove;
+            break;
+        }
+
+        stableIterations = (iterationBestMove == bestMove) ? stableIterations + 1 : 0;
+        bestMove = iterationBestMove;
+        completedDepth = searchDepth;
+        eval = iterationEval;
         if (SuperBoard.getCurrentSide() == BLACK) {
             eval *= -1;
         }
 
-        // * c. See how long the search was
-        searchTime = timer.end(); // end the timer
+        SuperBoard.getPV(PV);
+
+        // report on the iteration e.g. UCI info
+        if (SuperBoard.getInfoCallback()) {
+            searchResults.evaluation = eval;
+            searchResults.bestMove = bestMove;
+            searchResults.principleVariation = PV;
+            searchResults.stats = SuperBoard.getStats();
+            searchResults.searchTime = timeManager->elapsed();
+            searchResults.depth = completedDepth;
+            searchResults.searchCompleted = true;
+            SuperBoard.getInfoCallback()(searchResults);
+        }
+
         searchDepth = searchDepth + 1;
 
         // * d. This breaks the iterative deepening
-        // Firstly if the search is to a crazy depth, something is going wrong. Secondly, if a mate is found
-        if ((searchDepth > 50) || (abs(eval) >= MATE)) {
+        // Firstly if the search is to a crazy depth, something is going wrong.
+        // Secondly, if a mate is found. Reductions can hide a quicker mate, so we keep going until we've searched twice as deep as the mate.
+        if ((searchDepth > 50) || (isMateScore(eval) && (completedDepth >= 2 * mateDistance(eval)))) {
+            break;
+        }
+
+        // * e. See if we have time for another iteration
+        float timeScale = 1;
+        if (stableIterations == 0 && completedDepth > 1) {
+            timeScale *= searchParameters->unstableTimeScale;
+        } else if (stableIterations >= searchParameters->stableIterations) {
+            timeScale *= searchParameters->stableTimeScale;
+        }
+        if (iterationEval < previousEval - searchParameters->scoreDropMargin) {
+            timeScale *= searchParameters->scoreDropTimeScale;
+        }
+        previousEval = iterationEval;
+
+        SuperBoard.checkPonderhit();
+        if (!searchSignals->ponder && timeManager->shouldStopIterating(timeScale)) {
             break;
         }
     }
 
+    // if we were stopped before a single move was searched, just play something legal
+    if (!bestMove) bestMove = rootMoves.front();
+    if (PV.empty()) PV.assign(1, bestMove);
+
     // * 3. build the results object
     searchResults.evaluation = eval;
     searchResults.bestMove = bestMove;
     searchResults.searchCompleted = true;
-    SuperBoard.extractPV(searchResults.principleVariation); //todo remove first element and emplace the bestMove
+    searchResults.principleVariation = PV;
     searchResults.stats = SuperBoard.getStats();
-    searchResults.searchTime = searchTime;
-    searchResults.depth = searchDepth;
+    searchResults.searchTime = timeManager->elapsed();
+    searchResults.depth = completedDepth;
 
     return searchResults;
-}
+}
\ No newline at end of file
@@ -5,18 +5,56 @@
 #ifndef SEARCH_CPP_SEARCH_H
 #define SEARCH_CPP_SEARCH_H
 
+#include <atomic>
+#include <cmath>
+
 #define EXACT_EVAL 1
 #define LOWER_EVAL 2
 #define UPPER_EVAL 0
 
 #define INFIN 1000000
-#define MATE 100000
+#define MATE 30000 // every checkmate score is beyond this. they need to fit in the 16 bit TT evaluation
+
+#define MAX_PLY 128 // the deepest we can search from the root
+#define MAX_MOVES 256 // more than the most legal moves in any position
+
+#define TB_WIN (MATE - 2 * MAX_PLY) // a tablebase win at ply scores TB_WIN - ply. it's below every mate score, and above every evaluation
+#define TB_WIN_IN_MAX_PLY (TB_WIN - MAX_PLY) // every tablebase win and mate score is at least this. below it is a normal evaluation
+
+/* Mate scores
+ * Being mated at ply (distance from the root) scores -(MATE + MAX_PLY - ply), so a quicker mate is always a bigger score.
+ * The TT is shared between plies, so we store mate scores relative to the node instead of the root, and convert back when we read them.
+ * */
+inline int matedIn(int ply) {return -(MATE + MAX_PLY - ply);}
+inline int mateIn(int ply) {return MATE + MAX_PLY - ply;}
+inline bool isMateScore(int score) {return abs(score) >= MATE;}
+inline int mateDistance(int score) {return MATE + MAX_PLY - abs(score);} // the number of plies until mate
+inline int tbWinIn(int ply) {return TB_WIN - ply;}
+inline int tbLossIn(int ply) {return -TB_WIN + ply;}
+// tablebase wins/ losses depend on the ply as well, so they are converted in the same way
+inline int scoreToTT(int score, int ply) {
+    if (score >= TB_WIN_IN_MAX_PLY) return score + ply;
+    if (score <= -TB_WIN_IN_MAX_PLY) return score - ply;
+    return score;
+}
+inline int scoreFromTT(int score, int ply) {
+    if (score >= TB_WIN_IN_MAX_PLY) return score - ply;
+    if (score <= -TB_WIN_IN_MAX_PLY) return score + ply;
+    return score;
+}
+
+// move ordering scores. everything is ordered below the TT move, and quiet moves are ordered by their history score (which is less than KILLER_SCORE)
+#define TT_MOVE_SCORE 10000000
+#define CAPTURE_SCORE 1000000
+#define KILLER_SCORE 900000
+#define COUNTER_MOVE_SCORE 800000
+#define LOSING_CAPTURE_SCORE (-CAPTURE_SCORE)
 
 struct SearchParameters {
     struct TTParameters{
         int TTSizeMb = 0; // size of the TT in mb  (0 BY DEFAULT)
         int replaceDepth = 1; // the extra depth needed to overwrite a node (must be at least 1)
-        int replaceAge = 7; // the extra age needed to overwrite a node (must be at least 1)
+        int replaceAge = 2; // the extra age (in searches) needed to overwrite a node (must be at least 1)
 
         bool useTT = true; // whether we are using the TT in regular search
         bool useTTPruning = true; // whether we use the TT for pruning (move-ordering used by default)
@@ -26,9 +64,20 @@ struct SearchParameters {
     TTParameters ttParameters;
 
     /* Iterative deepening parameters */
-    float minSearchTime = 0.5; // the minimum time of a search in the iterative deepening framework
+    float minSearchTime = 0.5; // the search time used when we aren't given any limits (e.g. in debug mode)
     int startingDepth = 1; // the depth at which iterative deepening is started
 
+    /* Time management parameters */
+    int moveOverhead = 30; // the time (ms) we keep back for communication lag
+    int defaultMovesToGo = 30; // the number of moves we plan for if we aren't told (also the most we plan for)
+    float maxTimeScale = 5; // the most time we'll spend on a move, as a multiple of the optimum time
+    float maxTimeFraction = 0.8; // the most time we'll spend on a move, as a fraction of the clock
+    float unstableTimeScale = 1.5; // scale the optimum time by this if the best move changed in the last iteration
+    float stableTimeScale = 0.7; // scale the optimum time by this if the best move has been stable
+    int stableIterations = 3; // the number of iterations the best move must survive to be stable
+    int scoreDropMargin = 30; // if the score drops by more than this between iterations, we spend more time
+    float scoreDropTimeScale = 1.3; // scale the optimum time by this if the score drops
+
     /* Quiescence parameters */
     bool useQuiescence = true; // whether we use a quiescence search
     bool useSEE = true; // whether we use SEE
@@ -38,11 +87,70 @@ struct SearchParameters {
 
     /* Evaluation parameters */
     int stalemateEvaluation = -1000; // the evaluation of a stalemate position
+    int drawEvaluation = 0; // the evaluation of a draw by repetition or the fifty move rule
+    bool usePawnTable = true; // cache the pawn structure evaluation in the pawn table
+    bool useNNUE = true; // use the neural network evaluation, once a network has been loaded (e.g. with the UCI EvalFile option)
+    bool useEvalCache = true; // cache the static evaluation of each position, keyed by its zobrist hash
+    int evalCacheSizeMb = 2; // size of the eval cache in mb
 
     /* Main search parameters */
-    bool useLMR = false;
-    int useLMRDepth = 5; // the minimum depth we must be at for LMR
+    bool usePVS = true; // principal variation search: null window searches for every move after the first
+    bool useAspirationWindows = true; // start each iteration with a window around the last score
+    int aspirationWindow = 25; // the initial half-width of the aspiration window
+    int maxAspirationWindow = 500; // once the window grows past this we search the full window
+    int aspirationStartDepth = 4; // the depth at which we start using aspiration windows
+
+    bool useNullMove = true; // null move pruning: give the opponent a free move, and see if we still fail high
+    int nullMoveMinDepth = 3; // the minimum depth for a null move
+    int nullMoveReduction = 2; // the base depth reduction of the null move search
+    int nullMoveDepthDivisor = 4; // the reduction grows by 1 every this many plies of depth
+    int nullMoveVerifyDepth = 8; // at this depth or more, a null move cut-off is verified by a normal reduced search
+
+    /* Late move reduction parameters */
+    bool useLMR = true;
+    int LMRMinDepth = 3; // the minimum depth we must be at for LMR
     int minMovesBeforeLMR = 3; // the minimum full searches needed before a LMR
+    float LMRBase = 0.75; // reduction = LMRBase + log(depth) * log(move number) / LMRDivisor
+    float LMRDivisor = 2.25;
+
+    /* Extension parameters */
+    bool useCheckExtensions = true; // search moves that give check one ply deeper
+    bool useMateDistancePruning = true; // prune nodes that can't find a quicker mate than one we already have
+
+    bool useSingularExtensions = true; // extend the TT move if every other move is much worse
+    int singularMinDepth = 8;
+    int singularTTDepthMargin = 3; // the TT entry must be at least depth - this deep
+    int singularMargin = 2; // singular beta = TT evaluation - singularMargin * depth
+    bool useMultiCut = true; // if other moves also beat beta in the singular search, cut off
+
+    bool useIIR = true; // internal iterative reduction: search nodes without a TT move one ply shallower
+    int IIRMinDepth = 4;
+
+    /* Static evaluation pruning parameters. these are all only used in non-PV nodes near the leaves, when not in check */
+    bool useReverseFutility = true; // return the static evaluation if it beats beta by a margin
+    int reverseFutilityMaxDepth = 6;
+    int reverseFutilityMargin = 100; // the margin per ply of depth
+    bool useFutility = true; // skip quiet moves if the static evaluation is too far below alpha for them to raise it
+    int futilityMaxDepth = 3;
+    int futilityBase = 100; // margin = futilityBase + futilityMargin * depth
+    int futilityMargin = 100;
+    bool useRazoring = true; // if the static evaluation is far below alpha, check with a quiescence search and return if it fails low
+    int razoringMaxDepth = 2;
+    int razoringMargin = 300; // the margin per ply of depth
+
+    /* Tablebase parameters. the tables are only used once they've been loaded (e.g. with the UCI SyzygyPath option) */
+    bool useTablebases = true;
+    int syzygyProbeDepth = 1; // the minimum depth to probe at, unless there are fewer pieces than the largest table
+    bool syzygy50MoveRule = true; // treat cursed wins and blessed losses as draws
+
+    /* Move ordering parameters */
+    bool useKillers = true; // killer moves: quiet moves that caused a cut-off at the same ply
+    bool useHistory = true; // the history heuristic: order quiet moves by how often they cause cut-offs
+    bool useCounterMoves = true; // counter moves: the quiet move that refuted the opponent's last move
+    int maxHistory = 16384; // history scores are kept within [-maxHistory, maxHistory]
+
+    /* Stopping parameters */
+    int nodesBetweenStopChecks = 2048; // how often we check whether we've been told to stop (must be a power of 2)
 
     /* Multithreading parameters */
     bool useMultiThreading = false;
@@ -50,22 +158,53 @@ struct SearchParameters {
 };
 
 struct SearchStats {
-    int totalNodesSearched = 0;
+    long long totalNodesSearched = 0;
     int totalQuiescenceSearched = 0;
     int totalNonCaptureQSearched = 0; // count how many quiescence nodes aren't captures (ie. checks/ promos)
+    int totalTBHits = 0; // the number of successful tablebase probes
 
     void clear(){
         totalNodesSearched = 0;
         totalQuiescenceSearched = 0;
         totalNonCaptureQSearched = 0;
+        totalTBHits = 0;
     }
     void add(SearchStats s) {
         totalNodesSearched += s.totalNodesSearched;
         totalQuiescenceSearched += s.totalQuiescenceSearched;
         totalNonCaptureQSearched += s.totalNonCaptureQSearched;
+        totalTBHits += s.totalTBHits;
     }
 };
 
+/* The limits for a single search, mostly taken from the UCI go command.
+ * Times are in milliseconds, and 0 means there is no limit.
+ * */
+struct SearchLimits {
+    bool clock = false; // whether we were given the time left. it can be 0, when a clock has run out
+    long long time[2] = {0, 0}; // the time left on each side's clock
+    long long increment[2] = {0, 0}; // the increment for each side
+    int movesToGo = 0; // the number of moves until the next time control
+    long long moveTime = 0; // search for exactly this long
+    int depth = 0; // the maximum depth to search to
+    long long nodes = 0; // the maximum number of nodes to search
+    bool infinite = false; // search until we're told to stop
+};
+
+/* These are set from outside the search (i.e. by the UCI thread) while it's running.
+ * They're atomic as the search thread polls them.
+ * */
+struct SearchSignals {
+    std::atomic<bool> stop = false; // abort the search as soon as possible
+    std::atomic<bool> ponder = false; // we are searching on the opponent's time, so don't finish until a ponderhit/ stop
+
+    void clear() {
+        stop = false;
+        ponder = false;
+    }
+};
+SearchSignals noSignals; // used by boards that are never stopped from outside e.g. in debug mode
+
 struct SearchResults {
     int evaluation;
     int depth;
@@ -75,6 +214,24 @@ struct SearchResults {
     SearchStats stats;
     bool searchCompleted; // whether the search was completed or it failed e.g. because we are in check-mate.
 };
+typedef void (*SearchInfoCallback)(SearchResults &results); // used to report on the search after each iteration
+
+/* Late move reductions, indexed by [depth][number of moves searched].
+ * They're recalculated from the parameters at the start of each search, so they can be tuned. */
+int LMRReductions[64][64];
+void initLMRReductions(SearchParameters &params) {
+    for (int depth = 0; depth < 64; depth ++) {
+        for (int moveNumber = 0; moveNumber < 64; moveNumber ++) {
+            if (depth == 0 || moveNumber == 0) {
+                LMRReductions[depth][moveNumber] = 0;
+                continue;
+            }
+
+            double reduction = params.LMRBase + log(depth) * log(moveNumber) / params.LMRDivisor;
+            LMRReductions[depth][moveNumber] = std::max(0, (int) reduction);
+        }
+    }
+}
 
 inline short getEvaluationType(int eval, int alpha, int beta) {
     if (eval <= alpha) {
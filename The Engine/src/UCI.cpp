@@ -5,16 +5,40 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <mutex>
 #include "Search/SearchController.cpp"
+#include "Book/book.cpp"
 
 /* This code implements the UCI chess engine communication protocol */
 using namespace std;
 
 bool useDebugMode = false;
 
+/* The position we have currently set up on the UCIBoard.
+ * In a game the GUI sends the full move list every move, so we remember what we've already applied
+ * and only play the new moves on top. */
+string appliedPositionFEN;
+vector<string> appliedPositionMoves;
+
+const char UCIPromoChars[4] = {'b', 'n', 'r', 'q'}; // indexed by the promotion code
+
 SearchParameters _s;
 SearchController UCIBoard(_s);
 
+/* The search runs on its own thread, so we can keep reading commands (stop, ponderhit, isready) while it runs.
+ * The UCIBoard belongs to the search thread while it's running, so don't touch it until the search is stopped.
+ * */
+SearchSignals UCISignals;
+SearchLimits UCILimits; // the limits from the last go command
+thread searchThread;
+mutex outputMutex; // both threads write to cout
+
+/* Options */
+bool useOwnBook = false; // whether we play moves from the opening book, instead of searching
+string bookFile; // the path to a polyglot .bin book
+OpeningBook UCIBook;
+
 template <typename T> T popFront(vector<T> &vec) {
     if (vec.empty()) return T();
 
@@ -38,7 +62,10 @@ vector<string> getUserInput() {
     // get user input
     string input;
 
-    getline(cin, input);
+    if (!getline(cin, input)) {
+        // the input has been closed, so there's nothing left to do
+        return {"quit"};
+    }
 
     vector commands = commandToVector(input);
 
@@ -58,7 +85,8 @@ vector<string> getUserInput() {
     return commands;
 }
 void sendCommandString(string s) {
-    cout << s << "\n";
+    lock_guard<mutex> lock(outputMutex);
+    cout << s << endl; // flush, as the GUI is waiting on us
 }
 string moveToFENLong(Move m) {
     short fromSq, toSq, promo, flag, fromPc, toPc;
@@ -78,23 +106,22 @@ string moveToFENLong(Move m) {
 
         // see if we are promoting
         if (flag == PROMOTION) {
-            moveString += tolower(getPieceString(getPromoPiece(promo))[0]);
+            moveString += UCIPromoChars[promo];
         }
     }
 
     return moveString;
 }
+short squareFromString(const string &s, int offset) {
+    // converts a square string eg. "e4" to a square number. the board is flipped, so rank 8 is at the top
+    short file = s[offset] - 'a';
+    short rank = s[offset + 1] - '1';
+    return (7 - rank) * 8 + file;
+}
 Move FENLongToMove(string s) {
     // get the too and from squares
-    string fromString = s.substr(0, 2);
-    string toString = s.substr(2, 2);
-
-    // find what square number they correspond to
-    short from, to;
-    for (int i = 0; i < 64; i++) {
-        if (fromString == SquareStrings[i]) {from = i;}
-        if (toString == SquareStrings[i]) {to = i;}
-    }
+    short from = squareFromString(s, 0);
+    short to = squareFromString(s, 2);
 
     // see what move it is
     MoveList moves = UCIBoard.getMoveList();
@@ -102,6 +129,9 @@ Move FENLongToMove(string s) {
         short f, t, promo, flag, fromType, toType;
         decodeMove(move, f, t, promo, flag, fromType, toType);
         if ((f == from) && (t == to)) {
+            // if it's a promotion, make sure it's the right promotion piece
+            if ((flag == PROMOTION) && (s.size() > 4) && (UCIPromoChars[promo] != s[4])) continue;
+
             return move;
         }
 
@@ -125,8 +155,10 @@ void id() {
     sendCommandString("id name Chessington author Noah Joubert");
 }
 void option() {
-    //TODO
-
+    sendCommandString("option name OwnBook type check default false");
+    sendCommandString("option name BookFile type string default <empty>");
+    sendCommandString("option name SyzygyPath type string default <empty>");
+    sendCommandString("option name EvalFile type string default <empty>");
 }
 void uciok(){
     sendCommandString("uciok");
@@ -134,8 +166,38 @@ void uciok(){
 void readyok() {
     sendCommandString("readyok");
 }
-void bestmove(string FEN) {
-    sendCommandString("bestmove " + FEN);
+void bestmove(string FEN, string ponderFEN) {
+    if (ponderFEN.empty()) {
+        sendCommandString("bestmove " + FEN);
+    } else {
+        sendCommandString("bestmove " + FEN + " ponder " + ponderFEN);
+    }
+}
+void info(SearchResults &results) {
+    // reports on an iteration of the search. it's called on the search thread, between iterations, so the board is at the root
+    int score = results.evaluation * (UCIBoard.getCurrentSide() == WHITE ? 1 : -1); // the score is from our point of view
+    string scoreString;
+    if (isMateScore(score)) {
+        // UCI gives mates in moves, not plies. it's negative if we are being mated
+        int mateMoves = (mateDistance(score) + 1) / 2;
+        scoreString = "mate " + to_string(score > 0 ? mateMoves : -mateMoves);
+    } else {
+        scoreString = "cp " + to_string(score);
+    }
+
+    long long nodes = results.stats.totalNodesSearched;
+    long long time = results.searchTime * 1000; // in ms
+    long long nps = (time > 0) ? nodes * 1000 / time : 0;
+
+    long long TBHits = results.stats.totalTBHits;
+
+    string PVString;
+    for (Move move: results.principleVariation) {
+        PVString += " " + moveToFENLong(move);
+    }
+
+    sendCommandString("info depth " + to_string(results.depth) + " score " + scoreString + " nodes " + to_string(nodes) +
+                      " nps " + to_string(nps) + " tbhits " + to_string(TBHits) + " time " + to_string(time) + " pv" + PVString);
 }
 
 /* Inputs */
@@ -161,57 +223,138 @@ void debug(vector<string> &commandQueue) {
 
 }
 void setoption(vector<string> &commandQueue) {
-    // used to set an option for the engine
-
+    // used to set an option for the engine. it comes as "setoption name <name> [value <value>]", and both can contain spaces
 
     // get the name command
     string __ = popFront(commandQueue);
 
-    //TODO this
+    string name, value;
+    while (!commandQueue.empty() && commandQueue.front() != "value") {
+        name += (name.empty() ? "" : " ") + popFront(commandQueue);
+    }
+    popFront(commandQueue); // skip the 'value' command
+    while (!commandQueue.empty()) {
+        value += (value.empty() ? "" : " ") + popFront(commandQueue);
+    }
+
+    if (name == "OwnBook") {
+        useOwnBook = (value == "true");
+    } else if (name == "BookFile") {
+        bookFile = (value == "<empty>") ? "" : value;
+        if (bookFile.empty()) {
+            UCIBook.close();
+        } else if (!UCIBook.open(bookFile)) {
+            sendCommandString("info string could not open book " + bookFile);
+        }
+    } else if (name == "SyzygyPath") {
+        initTablebases((value == "<empty>") ? "" : value);
+        sendCommandString("info string found " + to_string(TBTables.size() / 2) + " tablebases");
+    } else if (name == "EvalFile") {
+        string evalFile = (value == "<empty>") ? "" : value;
+        // the cached evaluations (and the static evaluations in the TT) came from the old evaluation
+        UCIBoard.getEvalCache()->clear();
+        UCIBoard.getTT()->clear();
+
+        if (loadNNUE(evalFile)) {
+            sendCommandString("info string loaded network " + evalFile);
+        } else if (!evalFile.empty()) {
+            sendCommandString("info string could not load network " + evalFile + ", using the handcrafted evaluation");
+        }
+    }
 }
 void _register(vector<string> &commandQueue) {
 
 }
 void ucinewgame(vector<string> &commandQueue) {
+    // a new game is starting, so the old TT entries are no use to us
+    UCIBoard.getTT()->clear();
+    UCIBoard.getEvalCache()->clear();
 
+    // and we can't reuse the position we've set up
+    appliedPositionFEN.clear();
+    appliedPositionMoves.clear();
 }
 void position(vector<string> &commandQueue) {
     string command = popFront(commandQueue);
 
-    // first set the position
+    // first get the starting position
+    string FEN;
     if (command == "startpos") {
         // we are starting from the initial position
-        UCIBoard.readFEN(initialFEN);
+        FEN = initialFEN;
     } else if (command == "fen") {
-        // we are taking a fen input
+        // we are taking a fen input. it's everything up to the 'moves' command
+        while (!commandQueue.empty() && commandQueue.front() != "moves") {
+            FEN += popFront(commandQueue) + " ";
+        }
+    } else {
+        return;
+    }
 
-        static int FENStringComponents = 4; // an FEN string is made of 6 components
+    // now take the moves that are left over. we take them all at once, as popping them one by one is O(n^2)
+    vector<string> moves;
+    if (!commandQueue.empty()) {
+        moves.assign(commandQueue.begin() + 1, commandQueue.end()); // skip the 'moves' command
+        commandQueue.clear();
+    }
 
-        int numFENInputs = 0;
-        string FEN = "";
-        for (int i = 0; i < FENStringComponents; i ++) {
-            if (commandQueue.empty()) {
-                break;
-            }
+    // see if the new position just extends the one we've already set up
+    bool extendsApplied = (FEN == appliedPositionFEN) && (moves.size() >= appliedPositionMoves.size()) &&
+                          std::equal(appliedPositionMoves.begin(), appliedPositionMoves.end(), moves.begin());
+
+    size_t firstNewMove = appliedPositionMoves.size();
+    if (!extendsApplied) {
+        // we need to start from scratch
+        UCIBoard.readFEN(FEN);
+        appliedPositionFEN = FEN;
+        appliedPositionMoves.clear();
+        firstNewMove = 0;
+    }
 
-            numFENInputs ++;
-            FEN += popFront(commandQueue) + " ";
+    // make the new moves
+    for (size_t i = firstNewMove; i < moves.size(); i ++) {
+        if (UCIBoard.getMoveNumber() >= MAX_GAME_LENGTH - 1) {
+            sendCommandString("info string the game is too long, so the last moves were left out");
+            break;
         }
+        UCIBoard.makeMove(FENLongToMove(moves[i]));
+        appliedPositionMoves.emplace_back(moves[i]);
+    }
+}
+void stopSearch() {
+    // stop the search thread (if there is one), and wait for it to send its best move
+    if (searchThread.joinable()) {
+        UCISignals.stop = true;
+        searchThread.join();
+    }
+}
+void runSearch() {
+    /* This is run on the search thread */
+    SearchResults results = search(UCIBoard, UCILimits);
 
-        if (numFENInputs == FENStringComponents) {
-            UCIBoard.readFEN(FEN);
-        }
+    // we mustn't send a best move while pondering (or in an infinite search), so wait until we get a ponderhit or stop
+    while ((UCISignals.ponder || UCILimits.infinite) && !UCISignals.stop) {
+        this_thread::sleep_for(chrono::milliseconds(1));
     }
 
-    // now make any moves that are left over
-    if (commandQueue.empty()) return;
-    popFront(commandQueue); // pop the 'move' command
+    if (!results.searchCompleted) {
+        // there are no legal moves
+        bestmove("0000", "");
+        return;
+    }
 
-    while (!commandQueue.empty()) {
-        UCIBoard.makeMove(FENLongToMove(popFront(commandQueue)));
+    // the move we expect the opponent to play is second in the principle variation
+    string ponderFEN;
+    MoveList &PV = results.principleVariation;
+    if ((PV.size() >= 2) && (PV.front() == results.bestMove)) {
+        ponderFEN = moveToFENLong(PV[1]);
     }
+
+    bestmove(moveToFENLong(results.bestMove), ponderFEN);
 }
 void go(vector<string> &commandQueue) {
+    UCISignals.clear();
+    UCILimits = SearchLimits();
 
     while (!commandQueue.empty()) {
         string command = popFront(commandQueue);
@@ -219,25 +362,55 @@ void go(vector<string> &commandQueue) {
         if (command == "searchmoves") {
             // TODO this
         } else if (command == "ponder") {
-            // TODO this
+            // we are searching on the opponent's time. we don't stop until we get a ponderhit or stop
+            UCISignals.ponder = true;
+        } else if (command == "wtime") {
+            // the times are negative once a clock has run out
+            UCILimits.time[WHITE] = std::max(0LL, stoll(popFront(commandQueue)));
+            UCILimits.clock = true;
+        } else if (command == "btime") {
+            UCILimits.time[BLACK] = std::max(0LL, stoll(popFront(commandQueue)));
+            UCILimits.clock = true;
+        } else if (command == "winc") {
+            UCILimits.increment[WHITE] = std::max(0LL, stoll(popFront(commandQueue)));
+        } else if (command == "binc") {
+            UCILimits.increment[BLACK] = std::max(0LL, stoll(popFront(commandQueue)));
+        } else if (command == "movestogo") {
+            UCILimits.movesToGo = stoi(popFront(commandQueue));
+        } else if (command == "movetime") {
+            UCILimits.moveTime = stoll(popFront(commandQueue));
         } else if (command == "depth") {
-            // TODO this as well i guess
+            UCILimits.depth = stoi(popFront(commandQueue));
+        } else if (command == "nodes") {
+            UCILimits.nodes = stoll(popFront(commandQueue));
+        } else if (command == "infinite") {
+            UCILimits.infinite = true;
         }
     }
 
-    Move bestMove;
-    string twice;
-
-    //TODO yeah
-
-    SearchResults results = search(UCIBoard);
-    string fen = moveToFENLong(results.bestMove);
+    // if we're in book, play the book move straight away. we don't bother when pondering, as we'd have to wait for a ponderhit anyway
+    if (useOwnBook && !UCISignals.ponder && !UCILimits.infinite) {
+        Move bookMove = UCIBook.probe(UCIBoard);
+        if (bookMove) {
+            bestmove(moveToFENLong(bookMove), "");
+            return;
+        }
+    }
 
-    bestmove(fen);
+    // start searching in the background
+    searchThread = thread(runSearch);
+}
+void ponderhit() {
+    // the opponent played the move we were pondering on, so carry on searching as normal
+    UCISignals.ponder = false;
 }
 
 void mainLoopUCI(SearchParameters searchParams) {
     UCIBoard = SearchController(searchParams);
+    UCIBoard.joinNativeTT(); // the copy still points at the temporary's TT
+    UCIBoard.joinNativeEvalCache(); // and its eval cache
+    UCIBoard.joinSearchSignals(UCISignals);
+    UCIBoard.joinInfoCallback(info);
 
     /* Now go into the mainloop */
     bool mainLoopRunning = true;
@@ -264,6 +437,7 @@ void mainLoopUCI(SearchParameters searchParams) {
         } else if (command == "setoption") {
             stage = mainLoop;
         } else if (command == "quit") {
+            stopSearch();
             mainLoopRunning = false;
             break;
         }
@@ -273,22 +447,33 @@ void mainLoopUCI(SearchParameters searchParams) {
             continue;
         }
 
-        if (command == "debug") {
+        /* Commands that use the board must wait until the search is stopped.
+         * The rest (isready, ponderhit, debug) can come in while we're searching, so they are dealt with straight away. */
+        if (command == "stop") {
+            stopSearch();
+        } else if (command == "ponderhit") {
+            ponderhit();
+        } else if (command == "debug") {
             debug(commandQueue);
         } else if (command == "setoption") {
+            stopSearch();
             setoption(commandQueue);
         } else if (command == "register") {
             _register(commandQueue);
         } else if (command == "ucinewgame") {
+            stopSearch();
             ucinewgame(commandQueue);
         } else if (command == "position") {
+            stopSearch();
             position(commandQueue);
         } else if (command == "go") {
+            stopSearch();
             go(commandQueue);
         }
 
         // my custom commands
         if (command == "print") {
+            stopSearch();
             UCIBoard.printBoardPrettily();
         }
     }
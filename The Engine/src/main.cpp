@@ -10,7 +10,7 @@
 using namespace std;
 const string logsPath = getCWDString() + "/logs/";
 
-void printSearchResults(SearchResults results, SearchController SuperBoard) {
+void printSearchResults(SearchResults results, SearchController &SuperBoard) {
     SearchStats searchStats = results.stats;
     TranspositionTable *TT = SuperBoard.getTT();
 
@@ -40,7 +40,7 @@ void printSearchResults(SearchResults results, SearchController SuperBoard) {
     cout << "\tReturned move validation rate: " << (float) TT->totalTTMovesInMoveList / TT->totalTTMovesFound * 100 << "%\n";
     SuperBoard.printBoardPrettily();
 }
-string getFENPrefix(SearchController SuperBoard) {
+string getFENPrefix(SearchController &SuperBoard) {
     string FENFlag = "";
 
     Move move = SuperBoard.getMoveHistory().back();
@@ -73,7 +73,7 @@ string getFENPrefix(SearchController SuperBoard) {
 
     return FENFlag;
 }
-void engineAgainstSelf(SearchController SuperBoard) {
+void engineAgainstSelf(SearchController &SuperBoard) {
 
     // see what game 'number' this is
     string fileName = logsPath + "games/num.txt";
@@ -168,10 +168,20 @@ void debugMode(SearchParameters params) {
             cout << "Board evaluation: " << SuperBoard.relativeLazy() << "\n";
         } else if (command == "play") {
             engineAgainstSelf(SuperBoard);
+            moves = SuperBoard.getMoveList();
         } else if (command == "zobrist") {
             cout << "Current Zobrist key: " << SuperBoard.getZobristState() << "\n";
             cout << "Calculate Zobrist key: " << SuperBoard.calculateZobristHash() << "\n";
             cout << "All good: " << SuperBoard.validateZobrist() << "\n";
+        } else if (command == "kernels") {
+            // checks every set of NNUE kernels the CPU supports gives exactly the same results as the scalar ones
+            for (const NNUEKernelSet &kernels: supportedNNUEKernels()) {
+                cout << kernels.name << ": " << (checkNNUEKernels(kernels) ? "ok" : "MISMATCH") << "\n";
+            }
+        } else if (command == "polyglot") {
+            // the start position has a known polyglot key, which checks the random table
+            cout << "Polyglot key: " << hex << SuperBoard.getPolyglotKey() << dec << "\n";
+            cout << "Start position matches: " << (SearchController::getStartPolyglotKey() == POLYGLOT_START_KEY) << "\n";
         } else if (command == "unmove") {
             SuperBoard.unMakeMove();
             moves = SuperBoard.getMoveList();
@@ -220,6 +230,7 @@ void debugMode(SearchParameters params) {
 
 void init() {
     initStaticMasks(); // used to create various masks
+    initKPK(); // the KPK bitbase
 }
 
 int main() {
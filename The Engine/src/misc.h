@@ -99,10 +99,8 @@ void printMovesPrettily(MoveList moves) {
     allStrings[6][0] = "Move ID     | ";
 
     int i = 0;
-    while (!moves.empty()) {
+    for (Move move: moves) {
         i++;
-        Move move = moves.back();
-        moves.pop_back();
 
         int start = move & fromMask;
         int end = (move & toMask) >> 6;